@@ -6,24 +6,30 @@
 #include "DataStructure.h"
 #include "MeshInit.h"
 #include "Tools.h"
+#include "TPZGeoMeshHierarchy.h"
+#include "Solver.h"
+#include <set>
+#ifdef WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
-void Configure(ProblemConfig &config,int ndiv,PreConfig &pConfig,char *argv[]){
+TPZGeoMesh *CreateCoarseGeoMesh(PreConfig &pConfig){
+    TPZManVector<int, 4> bcids(4, -1);
+    if(pConfig.type != 2) return CreateGeoMesh(1, bcids); //rectangular mesh [0,1]x[0,1], matID = 1;
+    return CreateGeoMesh_OriginCentered(1, bcids); //rectangular mesh [-1,1]x[-1,1], matID_Q1-Q3 = alpha, matID_Q2-Q4 = beta
+}
+
+void Configure(ProblemConfig &config,int ndiv,PreConfig &pConfig,TPZGeoMeshHierarchy &hierarchy){
     ReadEntry(config, pConfig);
     config.ndivisions = ndiv;
     config.dimension = 2;
     config.prefine = false;
     config.exact.operator*().fSignConvention = 1;
 
-    // geometric mesh
-    TPZManVector<int, 4> bcids(4, -1);
-    TPZGeoMesh *gmesh;
-    if(pConfig.type != 2) gmesh = CreateGeoMesh(1, bcids); //rectangular mesh [0,1]x[0,1], matID = 1;
-    else {
-        gmesh = CreateGeoMesh_OriginCentered(1, bcids); //rectangular mesh [-1,1]x[-1,1], matID_Q1-Q3 = alpha, matID_Q2-Q4 = beta
-    }
-    UniformRefinement(config.ndivisions, gmesh);
-
-    config.gmesh = gmesh;
+    // geometric mesh: the finest level of the hierarchy, refined only by the levels it lacks
+    config.gmesh = hierarchy.LeafMesh(config.ndivisions);
     config.materialids.insert(1);
     config.bcmaterialids.insert(-1);
 
@@ -37,11 +43,6 @@ void Configure(ProblemConfig &config,int ndiv,PreConfig &pConfig,char *argv[]){
 
         SetMultiPermeMaterials(config.gmesh);
     }
-
-    if(pConfig.argc != 1) {
-        config.k = atoi(argv[3]);
-        config.n = atoi(argv[4]);
-    }
 }
 
 void ReadEntry(ProblemConfig &config, PreConfig &preConfig){
@@ -69,36 +70,32 @@ void ReadEntry(ProblemConfig &config, PreConfig &preConfig){
 }
 
 
-void InitializeOutstream(PreConfig &pConfig, char *argv[]){
-    //Error buffer
-    if( remove( "Erro.txt" ) != 0) perror( "Error deleting file" );
-    else puts( "Error log successfully deleted" );
-
-    pConfig.Erro.open("Erro.txt",std::ofstream::app);
-    pConfig.Erro << "----------COMPUTED ERRORS----------\n";
-
-    pConfig.Log = new TPZVec<REAL>(pConfig.numErrors, -1);
-    pConfig.rate = new TPZVec<REAL>(pConfig.numErrors, -1);
+static void MakeDirectory(const std::string &name){
+#ifdef WIN32
+    _mkdir(name.c_str());
+#else
+    mkdir(name.c_str(), 0777);
+#endif
+}
 
-    ProblemConfig config;
-    Configure(config,0,pConfig,argv);
+void InitializeOutstream(PreConfig &pConfig){
 
     std::stringstream out;
 
     switch(pConfig.mode) {
         case 0: //H1
-            out << "H1_" << config.problemname << "_k-"
-                << config.k;
+            out << "H1_" << pConfig.problem << "_k-"
+                << pConfig.k;
             pConfig.plotfile = out.str();
             break;
         case 1: //Hybrid
-            out << "Hybrid_" << config.problemname << "_k-"
-                << config.k << "_n-" << config.n;
+            out << "Hybrid_" << pConfig.problem << "_k-"
+                << pConfig.k << "_n-" << pConfig.n;
             pConfig.plotfile = out.str();
             break;
         case 2: // Mixed
-            out << "Mixed_" << config.problemname << "_k-"
-                << config.k << "_n-" << config.n;
+            out << "Mixed_" << pConfig.problem << "_k-"
+                << pConfig.k << "_n-" << pConfig.n;
             pConfig.plotfile = out.str();
             break;
         default:
@@ -106,75 +103,177 @@ void InitializeOutstream(PreConfig &pConfig, char *argv[]){
             DebugStop();
             break;
     }
-    std::string command = "mkdir " + pConfig.plotfile;
-    system(command.c_str());
-
-    std::string timer_name = pConfig.plotfile + "/timer.txt";
-
-    if( remove(timer_name.c_str()) != 0)
-        perror( "Error deleting file" );
-    else
-        puts( "Error log successfully deleted" );
-
-    pConfig.timer.open(timer_name, std::ofstream::app);
+    MakeDirectory(pConfig.plotfile);
+    if(!pConfig.snapshotDir.empty()) MakeDirectory(pConfig.snapshotDir);
+    if(!pConfig.checkpointDir.empty()) MakeDirectory(pConfig.checkpointDir);
 }
 
 void EvaluateEntry(int argc, char *argv[],PreConfig &pConfig){
-    if(argc != 1 && argc != 5){
+    if(argc != 1 && argc != 5 && argc != 6){
         std::cout << "Invalid entry";
         DebugStop();
     }
-    if(argc == 5){
+    if(argc >= 5){
         pConfig.argc = argc;
         for(int i = 3; i < 5 ; i++)
             IsInteger(argv[i]);
-        if(std::strcmp(argv[2], "H1") == 0)
-            pConfig.mode = 0;
-        else if(std::strcmp(argv[2], "Hybrid") == 0) {
-            pConfig.mode = 1;
-            if(pConfig.n < 1 ){
-                std::cout << "Unstable method\n";
-                DebugStop();
-            }
-        }
-        else if(std::strcmp(argv[2], "Mixed") == 0) {
-            pConfig.mode = 2;
-            if(pConfig.n < 0) DebugStop();
+        pConfig.problem = argv[1];
+        pConfig.approx = argv[2];
+        pConfig.k = atoi(argv[3]);
+        pConfig.n = atoi(argv[4]);
+        if(argc == 6) pConfig.solver = argv[5];
+    }
+
+    std::string error = EntryError(pConfig);
+    if(!error.empty()){
+        std::cout << error << "\n";
+        DebugStop();
+    }
+
+    if (pConfig.approx == "H1") pConfig.mode = 0;
+    else if (pConfig.approx == "Hybrid") pConfig.mode = 1;
+    else pConfig.mode = 2;
+
+    if (pConfig.problem == "ESinSin") pConfig.type = 0;
+    else if (pConfig.problem == "EArcTan") pConfig.type = 1;
+    else pConfig.type = 2;
+}
+
+std::string EntryError(const PreConfig &pConfig){
+    if (pConfig.approx != "H1" && pConfig.approx != "Hybrid" && pConfig.approx != "Mixed")
+        return "Invalid approximation " + pConfig.approx;
+    if (pConfig.problem != "ESinSin" && pConfig.problem != "EArcTan" && pConfig.problem != "ESteklovNonConst")
+        return "Invalid problem " + pConfig.problem;
+    if (pConfig.n < 0 && (pConfig.approx != "H1" || pConfig.problem == "ESteklovNonConst")) return "Invalid enrichment n";
+    if (pConfig.approx == "Hybrid" && pConfig.n < 1) return "Unstable method";
+    if (pConfig.problem == "EArcTan" && pConfig.approx != "H1" && pConfig.n < 1) return "Unstable method";
+
+    if(pConfig.solver == "pcg" && pConfig.approx != "H1")
+        return "pcg needs a positive definite system, the " + pConfig.approx + " system is a saddle point problem: use gmres";
+    if(!HasSolver(pConfig.solver, pConfig.approx)) return "Invalid solver " + pConfig.solver + " for " + pConfig.approx;
+    if(pConfig.preconditioner != "default" && pConfig.preconditioner != "element" && pConfig.preconditioner != "jacobi")
+        return "Invalid preconditioner " + pConfig.preconditioner;
+
+    // right hand side variants share the matrix: same domain and materials, factorized after the assembly
+    // their rows are told apart by problem, so each one appears once and differs from the problem of the case
+    std::set<std::string> variants;
+    for (auto &variant : pConfig.rhsVariants) {
+        bool stable = variant != "EArcTan" || pConfig.approx == "H1" || pConfig.n >= 1;
+        if ((variant != "ESinSin" && variant != "EArcTan") || pConfig.problem == "ESteklovNonConst" || !stable)
+            return "Invalid right hand side variant " + variant;
+        if (variant == pConfig.problem || !variants.insert(variant).second)
+            return "Right hand side variant " + variant + " is solved twice";
+    }
+    if (pConfig.rhsVariants.size() && (pConfig.solver == "frontal" || pConfig.solver == "pcg" || pConfig.solver == "gmres"))
+        return "Right hand side variants need a direct solver factorized after the assembly";
+    return "";
+}
+
+bool IsBatchEntry(int argc, char *argv[]){
+    if(argc < 2) return false;
+    return std::strcmp(argv[1], "--batch") == 0;
+}
+
+static void SplitList(const std::string &list, TPZStack<std::string> &items){
+    std::stringstream ss(list);
+    std::string item;
+    while(getline(ss, item, ',')){
+        if(!item.empty()) items.Push(item);
+    }
+}
+
+static void ReadIntList(const std::string &list, TPZStack<int> &values){
+    TPZStack<std::string> items;
+    SplitList(list, items);
+    for(auto &item : items){
+        size_t dash = item.find('-', 1);
+        if(dash == std::string::npos){
+            values.Push(atoi(item.c_str()));
+            continue;
         }
-        else DebugStop();
+        int first = atoi(item.substr(0, dash).c_str());
+        int last = atoi(item.substr(dash+1).c_str());
+        for(int value = first; value <= last; value++) values.Push(value);
+    }
+}
+
+static void AddBatchCase(const BatchCase &entry, const PreConfig &defaults, std::set<std::string> &added, TPZStack<BatchCase> &cases){
+    // the H1 approximation does not depend on n, it is run once per k
+    std::stringstream key;
+    key << entry.problem << "_" << entry.approx << "_" << entry.k;
+    if(entry.approx != "H1") key << "_" << entry.n;
+    if(added.count(key.str())) return;
 
-        if(std::strcmp(argv[1], "ESinSin") == 0) {
-            pConfig.type = 0;
-            pConfig.problem = "ESinSin";
+    // invalid combinations of a range are skipped here, EvaluateEntry would stop the whole batch
+    PreConfig pConfig = defaults;
+    pConfig.problem = entry.problem;
+    pConfig.approx = entry.approx;
+    pConfig.k = entry.k;
+    pConfig.n = entry.n;
+    std::string error = EntryError(pConfig);
+    if(!error.empty()){
+        std::cout << "Skipping batch case " << key.str() << ": " << error << std::endl;
+        return;
+    }
+    added.insert(key.str());
+    cases.Push(entry);
+}
+
+void ReadBatchEntry(int argc, char *argv[], const PreConfig &defaults, TPZStack<BatchCase> &cases){
+    std::set<std::string> added;
+    if(argc == 3){
+        std::ifstream input(argv[2]);
+        if(!input){
+            std::cerr << "Could not open batch file " << argv[2] << '\n';
+            DebugStop();
         }
-        else if(std::strcmp(argv[1], "EArcTan") == 0) {
-            pConfig.type = 1;
-            if(pConfig.n < 1 ){
-                std::cout << "Unstable method\n";
+        string Line;
+        while(getline(input, Line)){
+            if(Line.empty() || Line[0] == '#') continue;
+            std::istringstream ss(Line);
+            BatchCase entry;
+            if(!(ss >> entry.problem >> entry.approx >> entry.k >> entry.n)){
+                std::cerr << "Invalid batch line: " << Line << '\n';
                 DebugStop();
             }
-            pConfig.problem = "EArcTan";
-        }
-        else if(std::strcmp(argv[1], "ESteklovNonConst") == 0) {
-            pConfig.type = 2;
-            if(pConfig.n < 0) DebugStop();
-            pConfig.problem = "ESteklovNonConst";
+            AddBatchCase(entry, defaults, added, cases);
         }
-        else DebugStop();
+    }
+    else if(argc == 6){
+        TPZStack<std::string> problems, approxs;
+        TPZStack<int> ks, ns;
+        SplitList(argv[2], problems);
+        SplitList(argv[3], approxs);
+        ReadIntList(argv[4], ks);
+        ReadIntList(argv[5], ns);
+        for(auto &problem : problems) for(auto &approx : approxs)
+            for(auto k : ks) for(auto n : ns){
+                BatchCase entry;
+                entry.problem = problem;
+                entry.approx = approx;
+                entry.k = k;
+                entry.n = n;
+                AddBatchCase(entry, defaults, added, cases);
+            }
     }
     else{
-        if (pConfig.approx == "H1") pConfig.mode = 0;
-        else if (pConfig.approx == "Hybrid")  pConfig.mode = 1;
-        else if (pConfig.approx == "Mixed") pConfig.mode = 2;
-        else DebugStop();
-
-        if (pConfig.problem== "ESinSin") pConfig.type= 0;
-        else if (pConfig.problem=="EArcTan")  pConfig.type = 1;
-        else if (pConfig.problem == "ESteklovNonConst") pConfig.type = 2;
-        else DebugStop();
+        std::cout << "Invalid entry";
+        DebugStop();
     }
 }
 
+void SetBatchCase(PreConfig &pConfig, const PreConfig &defaults, const BatchCase &entry){
+    pConfig = defaults;
+
+    pConfig.problem = entry.problem;
+    pConfig.approx = entry.approx;
+    pConfig.k = entry.k;
+    pConfig.n = entry.n;
+    // the cases are already solved concurrently, their levels are not
+    pConfig.parallelSweep = false;
+    EvaluateEntry(1, nullptr, pConfig);
+}
+
 void IsInteger(char *argv){
     std::istringstream ss(argv);
     int x;
@@ -9,9 +9,29 @@
 
 
 void EvaluateEntry(int argc, char *argv[],PreConfig &eData);
+//// Reason why the case selected in eData cannot be run, empty if it is valid
+std::string EntryError(const PreConfig &eData);
 void ReadEntry(ProblemConfig &config, PreConfig &preConfig);
-void InitializeOutstream(PreConfig &eData,char *argv[]);
+void InitializeOutstream(PreConfig &eData);
 void IsInteger(char *argv);
-void Configure(ProblemConfig &config,int ndiv,PreConfig &pConfig,char *argv[]);
+
+class TPZGeoMeshHierarchy;
+//// Coarsest (1x1) geometric mesh of the domain selected in pConfig
+TPZGeoMesh *CreateCoarseGeoMesh(PreConfig &pConfig);
+
+//// Fill config for the refinement level ndiv, taking its geometric mesh from the hierarchy
+void Configure(ProblemConfig &config,int ndiv,PreConfig &pConfig,TPZGeoMeshHierarchy &hierarchy);
+
+//// True if the command line asks for a batch study: "--batch <file>" or "--batch <problems> <approxs> <k range> <n range>"
+bool IsBatchEntry(int argc, char *argv[]);
+
+//// Expand the batch command line into the list of cases to be run
+//// Lists are comma separated and integer ranges are written as "1-3"
+//// Combinations which EvaluateEntry rejects with the settings of defaults are reported and skipped
+void ReadBatchEntry(int argc, char *argv[], const PreConfig &defaults, TPZStack<BatchCase> &cases);
+
+//// Copy the study settings of defaults to pConfig and select the case given by entry
+//// The levels of a case are solved one after the other, parallelSweep is ignored
+void SetBatchCase(PreConfig &pConfig, const PreConfig &defaults, const BatchCase &entry);
 
 #endif //FEMCOMPARISON_INPUTTREATMENT_H
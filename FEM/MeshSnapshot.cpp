@@ -0,0 +1,173 @@
+//
+// MeshSnapshot.cpp
+// FEMcomparison
+//
+
+#include "MeshSnapshot.h"
+#include <TPZMultiphysicsCompMesh.h>
+#include "pzcmesh.h"
+#include "pzgmesh.h"
+#include "TPZPersistenceManager.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+//// TPZPersistenceManager keeps a single session, levels and batch cases solved concurrently take turns
+static std::mutex gSnapshotMutex;
+
+std::string SnapshotFile(const PreConfig &pConfig, int ndiv, int hybridLevel){
+    if(pConfig.snapshotDir.empty()) return "";
+    // the problem enters the key through its type, which selects the domain and the exact solution
+    // the forcing functions are not stored, the materials are inserted again when the meshes are read
+    std::stringstream file;
+    file << pConfig.snapshotDir << "/" << pConfig.approx << "_type" << pConfig.type << "_ndiv" << ndiv
+         << "_k" << pConfig.k << "_n" << pConfig.n;
+    if(pConfig.mode == 1) file << "_hybrid" << hybridLevel;
+    file << ".pzsnap";
+    return file.str();
+}
+
+//// Companion file of a snapshot holding the number of equations of its multiphysics mesh
+static std::string EquationsFile(const std::string &file){
+    return file + ".neq";
+}
+
+#ifdef PZDEBUG
+//// Read file back and compare it with the mesh it was written from
+static void CheckMeshSnapshot(const std::string &file, TPZMultiphysicsCompMesh *cmesh){
+    int64_t neq = 0;
+    TPZMultiphysicsCompMesh *restored = ReadMeshSnapshot(file, neq);
+    if(!restored) DebugStop();
+    TPZGeoMesh *gmesh = restored->Reference();
+    auto atomic = restored->MeshVector();
+    restored->InitializeBlock();
+    if(restored->NEquations() != cmesh->NEquations() || restored->NElements() != cmesh->NElements() ||
+       restored->NConnects() != cmesh->NConnects()) {
+        std::cout << "The mesh snapshot " << file << " does not match the mesh it was written from" << std::endl;
+        DebugStop();
+    }
+    delete restored;
+    for (auto mesh : atomic) delete mesh;
+    delete gmesh;
+}
+#endif
+
+void WriteMeshSnapshot(const std::string &file, TPZMultiphysicsCompMesh *cmesh){
+    if(file.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(gSnapshotMutex);
+
+        // the materials of the multiphysics mesh hold the forcing and exact functions, which cannot be read back;
+        // they are left out of the file and inserted again by the reader
+        std::map<int, TPZMaterial *> materials;
+        std::swap(materials, cmesh->MaterialVec());
+
+        // the file only appears once it is complete
+        std::string partial = file + ".partial";
+        TPZPersistenceManager::OpenWrite(partial);
+        TPZPersistenceManager::WriteToFile(cmesh->Reference());
+        for (auto mesh : cmesh->MeshVector()) TPZPersistenceManager::WriteToFile(mesh);
+        TPZPersistenceManager::WriteToFile(cmesh);
+        TPZPersistenceManager::CloseWrite();
+        std::swap(materials, cmesh->MaterialVec());
+
+        // the number of equations lets the reader check the restored mesh against the one written here
+        std::ofstream(EquationsFile(file)) << cmesh->NEquations() << std::endl;
+        if(std::rename(partial.c_str(), file.c_str())) {
+            std::cout << "Could not write the mesh snapshot " << file << std::endl;
+            return;
+        }
+    }
+#ifdef PZDEBUG
+    CheckMeshSnapshot(file, cmesh);
+#endif
+}
+
+TPZMultiphysicsCompMesh *ReadMeshSnapshot(const std::string &file, int64_t &neq){
+    if(file.empty()) return 0;
+    std::lock_guard<std::mutex> lock(gSnapshotMutex);
+    if(!std::ifstream(file).good()) return 0;
+    std::ifstream equations(EquationsFile(file));
+    if(!(equations >> neq)) return 0;
+
+    TPZPersistenceManager::OpenRead(file);
+    TPZGeoMesh *gmesh = dynamic_cast<TPZGeoMesh *>(TPZPersistenceManager::ReadFromFile());
+    TPZSavable *object = TPZPersistenceManager::ReadFromFile();
+    while(object && !dynamic_cast<TPZMultiphysicsCompMesh *>(object)) object = TPZPersistenceManager::ReadFromFile();
+    TPZMultiphysicsCompMesh *cmesh = dynamic_cast<TPZMultiphysicsCompMesh *>(object);
+    TPZPersistenceManager::CloseRead();
+
+    if(!gmesh || !cmesh || cmesh->Reference() != gmesh) DebugStop();
+    return cmesh;
+}
+
+std::string CheckpointFile(const PreConfig &pConfig, int ndiv){
+    if(pConfig.checkpointDir.empty()) return "";
+    std::stringstream file;
+    file << pConfig.checkpointDir << "/" << pConfig.plotfile << "_ndiv" << ndiv;
+    return file.str();
+}
+
+void WriteCheckpointSolution(const std::string &file, TPZCompMesh *cmesh){
+    if(file.empty()) return;
+    std::lock_guard<std::mutex> lock(gSnapshotMutex);
+    std::string partial = file + ".pzsol.partial";
+    TPZPersistenceManager::OpenWrite(partial);
+    TPZPersistenceManager::WriteToFile(&cmesh->Solution());
+    TPZPersistenceManager::CloseWrite();
+    if(std::rename(partial.c_str(), (file + ".pzsol").c_str())) {
+        std::cout << "Could not write the solution checkpoint " << file << std::endl;
+    }
+}
+
+void WriteCheckpointRows(const std::string &file, const TPZVec<LevelResult *> &rows){
+    if(file.empty()) return;
+    std::string partial = file + ".rows.partial";
+    {
+        std::ofstream out(partial);
+        out << std::setprecision(std::numeric_limits<REAL>::max_digits10);
+        out << rows.size() << "\n";
+        for (auto row : rows) {
+            out << row->problem << " " << row->ndiv << " " << row->h << " " << row->dof << " " << row->errors.size();
+            for (auto error : row->errors) out << " " << error;
+            out << " " << row->time;
+            for (int iphase = 0; iphase < ENumPhases; iphase++) out << " " << row->phaseTime[iphase] << " " << row->phaseCpu[iphase];
+            out << " " << row->iterations << " " << row->residual << " " << row->memory << " " << row->peakMemory << "\n";
+        }
+    }
+    if(std::rename(partial.c_str(), (file + ".rows").c_str())) {
+        std::cout << "Could not write the level checkpoint " << file << std::endl;
+    }
+}
+
+bool ReadCheckpointRows(const std::string &file, TPZVec<LevelResult *> &rows){
+    if(file.empty()) return false;
+    std::ifstream in(file + ".rows");
+    int64_t nrows = 0;
+    if(!(in >> nrows) || nrows != rows.size()) return false;
+
+    // the rows are only filled once the whole file has been read
+    TPZVec<LevelResult> saved(nrows);
+    for (int64_t irow = 0; irow < nrows; irow++) {
+        LevelResult &row = saved[irow];
+        int64_t nerrors = 0;
+        if(!(in >> row.problem >> row.ndiv >> row.h >> row.dof >> nerrors) || nerrors < 0) return false;
+        row.errors.Resize(nerrors);
+        for (auto &error : row.errors) in >> error;
+        in >> row.time;
+        for (int iphase = 0; iphase < ENumPhases; iphase++) in >> row.phaseTime[iphase] >> row.phaseCpu[iphase];
+        in >> row.iterations >> row.residual >> row.memory >> row.peakMemory;
+        if(!in || row.problem != rows[irow]->problem) return false;
+    }
+    for (int64_t irow = 0; irow < nrows; irow++) {
+        saved[irow].variants = rows[irow]->variants;
+        *rows[irow] = saved[irow];
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+//
+// MeshSnapshot.h
+// FEMcomparison
+//
+
+#ifndef FEMCOMPARISON_MESHSNAPSHOT_H
+#define FEMCOMPARISON_MESHSNAPSHOT_H
+
+#include <string>
+#include "DataStructure.h"
+
+class TPZCompMesh;
+class TPZMultiphysicsCompMesh;
+
+//// File holding the meshes of a Hybrid or Mixed level, keyed by (approx, type, ndiv, k, n, hybridLevel)
+//// Empty if pConfig.snapshotDir is not set
+std::string SnapshotFile(const PreConfig &pConfig, int ndiv, int hybridLevel);
+
+//// Write the multiphysics mesh together with its geometric and atomic meshes, and its number of equations
+//// The material objects of the multiphysics mesh are left out, the reader inserts them again
+//// Debug builds read the file back and compare it with cmesh
+void WriteMeshSnapshot(const std::string &file, TPZMultiphysicsCompMesh *cmesh);
+
+//// Read the meshes written by WriteMeshSnapshot, 0 if file does not exist
+//// neq receives the number of equations the mesh had when it was written
+//// The caller owns the returned mesh, its geometric mesh and its atomic meshes
+TPZMultiphysicsCompMesh *ReadMeshSnapshot(const std::string &file, int64_t &neq);
+
+//// Name shared by the checkpoint files of level ndiv of the study of pConfig (its plotfile)
+//// Empty if pConfig.checkpointDir is not set
+std::string CheckpointFile(const PreConfig &pConfig, int ndiv);
+
+//// Save the solution of a solved level, before its meshes are released
+void WriteCheckpointSolution(const std::string &file, TPZCompMesh *cmesh);
+
+//// Save the table rows of a level: its own row followed by those of its right hand side variants
+//// A level counts as checkpointed once its rows are written
+void WriteCheckpointRows(const std::string &file, const TPZVec<LevelResult *> &rows);
+
+//// Read the rows written by WriteCheckpointRows into rows, whose problems must match the saved ones
+//// False if the level was not checkpointed
+bool ReadCheckpointRows(const std::string &file, TPZVec<LevelResult *> &rows);
+
+#endif //FEMCOMPARISON_MESHSNAPSHOT_H
@@ -6,28 +6,77 @@
 #include "InputTreatment.h"
 #include "DataStructure.h"
 
-void FlushTime(PreConfig &pConfig, clock_t start){
-    float timer = float( clock () - start )/CLOCKS_PER_SEC;
-    pConfig.timer << "Simulation time (" << pConfig.h << "x" << pConfig.h <<"): " << timer << "\n";
-    pConfig.timer.flush();
+#include <cmath>
+#ifdef USING_MKL
+#include <mkl.h>
+#endif
+
+//// Names of the table columns and the error index stored in each of them
+//// PostProcessError returns the L2 error first for the Hybrid and Mixed materials
+static const char *gErrorNames[3] = {"semiH1", "L2", "3rd"};
+
+//// Names of the wall-clock time columns, in ESolvePhase order
+static const char *gPhaseNames[ENumPhases] = {"mesh", "atomic", "interfaces", "condensation", "assembly",
+                                              "factorization", "backsubstitution", "errors", "postprocess"};
+
+//// Threads of the policy running each phase, the remaining phases are serial
+//// The condensation phase of Hybrid groups the elements on the mesh threads, the others condense serially
+static int PhaseThreads(const PreConfig &pConfig, int phase){
+    const ThreadingPolicy &threads = pConfig.threads;
+    int nthreads = 1;
+    switch(phase) {
+        case EAssembly:
+            nthreads = threads.assemble;
+            break;
+        case EFactorization:
+        case EBackSubstitution:
+#ifdef USING_MKL
+            nthreads = threads.factorize > 0 ? threads.factorize : mkl_get_max_threads();
+#endif
+            break;
+        case EErrorEvaluation:
+            nthreads = threads.error;
+            break;
+        case EInterfaces:
+            nthreads = threads.mesh;
+            break;
+        case ECondensation:
+            if(pConfig.mode == 1) nthreads = threads.mesh;
+            break;
+        default:
+            break;
+    }
+    return nthreads > 0 ? nthreads : 1;
 }
 
-void FlushTable(PreConfig &pConfig, char *argv[]){
-
-    std::string plotname;
-    plotname = pConfig.plotfile + "/" + pConfig.plotfile + ".csv";
-
-    remove(plotname.c_str());
-    ofstream table(plotname.c_str(), ios::app);
+//// Processor time over wall time times the number of threads of the phase, -1 if the phase did not run
+//// The processor time is that of the whole process, so it is -1 as well when other levels or cases ran meanwhile
+static REAL Efficiency(const PreConfig &pConfig, const LevelResult &level, int phase){
+    if(level.phaseTime[phase] <= 0. || pConfig.concurrentLevels) return -1.;
+    return level.phaseCpu[phase]/(level.phaseTime[phase]*PhaseThreads(pConfig, phase));
+}
 
-    ProblemConfig config;
-    Configure(config, 0, pConfig, argv);
+static int ErrorIndex(int mode, int column){
+    if((mode == 1 || mode == 2) && column < 2) return 1-column;
+    return column;
+}
 
-    pConfig.Erro.close();
-    string file = "Erro.txt";
-    CleanErrors(file);
+void ComputeRates(PreConfig &pConfig){
+    TPZVec<LevelResult> &results = pConfig.results;
+    for (int ilevel = 1; ilevel < results.size(); ilevel++) {
+        LevelResult &coarse = results[ilevel-1];
+        LevelResult &fine = results[ilevel];
+        // the rows of each right hand side are contiguous
+        if (coarse.problem != fine.problem) continue;
+        fine.rates.Resize(3);
+        for (int j = 0; j < 3; j++) {
+            fine.rates[j] = (log10(fine.errors[j]) - log10(coarse.errors[j])) /
+                            (log10(fine.h) - log10(coarse.h));
+        }
+    }
+}
 
-    if(pConfig.mode == 1 || pConfig.mode == 2) InvertError(file);
+static void WriteCsvTable(PreConfig &pConfig, ofstream &table){
 
     table << "Geometry" << "," << "Quadrilateral" << "\n";
     table << "Refinement" << "," << "Uniform" << "\n";
@@ -35,211 +84,118 @@ void FlushTable(PreConfig &pConfig, char *argv[]){
 
     if (pConfig.type != 2) table << "," << "[0 1]x[0 1]" << "\n";
     else table << "," << "[-1 1]x[-1 1]" << "\n";
-    table << "Case" << "," << config.problemname << "\n";
+    table << "Case" << "," << pConfig.problem << "\n";
     switch(pConfig.mode) {
         case 0:
             table << "Approximation" << "," << "H1" << "\n";
-            table << "p order"  << "," << config.k << "\n";
+            table << "p order"  << "," << pConfig.k << "\n";
             table << "---" << "," << "---" <<  "\n\n";
             table << "Norm" << "," << "H1" << "\n";
             break;
         case 1:
             table << "Approximation" << "," << "Hybrid" << "\n";
-            table << "k order"  << "," << config.k << "\n";
-            table << "Enrichment +n" << "," << config.n <<  "\n\n";
+            table << "k order"  << "," << pConfig.k << "\n";
+            table << "Enrichment +n" << "," << pConfig.n <<  "\n\n";
             table << "Norm" << "," << "Hybrid" << "\n";
             break;
         case 2:
             table << "Approximation" << "," << "Mixed" << "\n";
-            table << "k order" << "," << config.k << "\n";
-            table << "Enrichment +n" << "," << config.n<<  "\n\n";
+            table << "k order" << "," << pConfig.k << "\n";
+            table << "Enrichment +n" << "," << pConfig.n<<  "\n\n";
             table << "Norm" << "," << "Mixed" << "\n";
             break;
     }
-    FillErrors(table, file, pConfig.mode);
-    table.close();
+    table << "\n";
+
+    table << "problem,ndiv,h,DOF";
+    for (int j = 0; j < 3; j++) table << "," << gErrorNames[j] << "-error";
+    for (int j = 0; j < 3; j++) table << "," << gErrorNames[j] << "-rate";
+    table << ",time";
+    for (int iphase = 0; iphase < ENumPhases; iphase++) table << "," << gPhaseNames[iphase] << "-time";
+    for (int iphase = 0; iphase < ENumPhases; iphase++) table << "," << gPhaseNames[iphase] << "-efficiency";
+    table << ",iterations,residual,rss-MB,peak-rss-MB\n";
+
+    for (auto &level : pConfig.results) {
+        table << level.problem << "," << level.ndiv << "," << level.h << "," << level.dof;
+        for (int j = 0; j < 3; j++) table << "," << level.errors[ErrorIndex(pConfig.mode, j)];
+        for (int j = 0; j < 3; j++) {
+            table << ",";
+            if (level.rates.size()) table << level.rates[ErrorIndex(pConfig.mode, j)];
+        }
+        // the rows of right hand side variants have no time of their own, they share the solve of their level
+        table << ",";
+        if (level.time >= 0.) table << level.time;
+        for (int iphase = 0; iphase < ENumPhases; iphase++) table << "," << level.phaseTime[iphase];
+        for (int iphase = 0; iphase < ENumPhases; iphase++) table << "," << Efficiency(pConfig, level, iphase);
+        table << "," << level.iterations << "," << level.residual;
+        table << "," << level.memory << "," << level.peakMemory << "\n";
+    }
 }
 
-void InvertError(string file){
-    std::vector<std::string> erro,rate;
-    std::string sErro,sRate;
-    int size = 0;
-
-    std::ifstream iErro(file);
-    std::ofstream temp("temp.txt");
-
-    int it_count = -1, hash_count = 0;
-    string Line;
-    while(getline(iErro,Line)){
-        it_count++;
-        if (it_count == 0) {
-            temp << Line << endl;
-            continue;
-        }
+//// JSON has no nan or inf, values which are not finite are written as null
+struct JsonNumber{
+    REAL value;
+};
 
-        hash_count++;
-        if (Line.find("#") != string::npos) hash_count = 0;
-
-        switch (hash_count) {
-            case (1):
-                sErro = Line;
-                temp << Line << endl;
-                continue;
-            case (2):
-                temp << sErro << endl;
-                erro.push_back(Line);
-                break;
-            case (4):
-                if (it_count == 5)
-                    temp << Line << endl;
-                else{
-                    sRate = Line;
-                    temp << Line << endl;
-                }
-                break;
-            case (5):
-                if (it_count == 6)
-                    temp << Line << endl;
-                else {
-                    temp << sRate << endl;
-                    rate.push_back(Line);
-                }
-                break;
-            default:
-                temp << Line << endl;
-                break;
-        }
-    }
-    temp.close();
-
-    remove(file.c_str());
-    std::ifstream itemp("temp.txt");
-    std::ofstream Erro(file.c_str());
-
-    it_count = -1; hash_count =0;
-    int erro_counter =0, rate_counter =0;
-    while(getline(itemp,Line)){
-        it_count++;
-        if (it_count == 0) {
-            Erro << Line << endl;
-            continue;
-        }
+static std::ostream &operator<<(std::ostream &out, const JsonNumber &number){
+    if(std::isfinite(number.value)) return out << number.value;
+    return out << "null";
+}
 
-        hash_count++;
-        if (Line.find("#") != string::npos) hash_count = 0;
-
-        switch (hash_count) {
-            case (1):
-                Erro << erro[erro_counter] << endl;
-                erro_counter++;
-                break;
-            case (4):
-                if (it_count == 5)
-                    Erro << Line << endl;
-                else{
-                    Erro << rate[rate_counter] << endl;
-                    rate_counter++;
-                }
-                break;
-            default:
-                Erro << Line << endl;
-                continue;
+static void WriteJsonTable(PreConfig &pConfig, ofstream &table){
+
+    table << "{\n";
+    table << "  \"geometry\": \"Quadrilateral\",\n";
+    table << "  \"refinement\": \"Uniform\",\n";
+    table << "  \"domain\": \"" << (pConfig.type != 2 ? "[0 1]x[0 1]" : "[-1 1]x[-1 1]") << "\",\n";
+    table << "  \"case\": \"" << pConfig.problem << "\",\n";
+    table << "  \"approximation\": \"" << pConfig.approx << "\",\n";
+    table << "  \"k\": " << pConfig.k << ",\n";
+    table << "  \"n\": " << pConfig.n << ",\n";
+    table << "  \"levels\": [";
+
+    for (int ilevel = 0; ilevel < pConfig.results.size(); ilevel++) {
+        LevelResult &level = pConfig.results[ilevel];
+        table << (ilevel ? ",\n" : "\n");
+        table << "    {\"problem\": \"" << level.problem << "\", \"ndiv\": " << level.ndiv << ", \"h\": " << JsonNumber{level.h} << ", \"DOF\": " << level.dof;
+        for (int j = 0; j < 3; j++)
+            table << ", \"" << gErrorNames[j] << "-error\": " << JsonNumber{level.errors[ErrorIndex(pConfig.mode, j)]};
+        for (int j = 0; j < 3; j++) {
+            table << ", \"" << gErrorNames[j] << "-rate\": ";
+            if (level.rates.size()) table << JsonNumber{level.rates[ErrorIndex(pConfig.mode, j)]};
+            else table << "null";
         }
+        table << ", \"time\": ";
+        if (level.time >= 0.) table << JsonNumber{level.time};
+        else table << "null";
+        for (int iphase = 0; iphase < ENumPhases; iphase++)
+            table << ", \"" << gPhaseNames[iphase] << "-time\": " << JsonNumber{level.phaseTime[iphase]};
+        for (int iphase = 0; iphase < ENumPhases; iphase++)
+            table << ", \"" << gPhaseNames[iphase] << "-efficiency\": " << JsonNumber{Efficiency(pConfig, level, iphase)};
+        table << ", \"iterations\": " << level.iterations << ", \"residual\": " << JsonNumber{level.residual};
+        table << ", \"rss-MB\": " << JsonNumber{level.memory} << ", \"peak-rss-MB\": " << JsonNumber{level.peakMemory} << "}";
     }
-    itemp.close();
-    remove("temp.txt");
+    table << "\n  ]\n}\n";
 }
 
-void FillErrors(ofstream &table,string f,int mode){
-    std::ifstream iErro(f.c_str());
+void FlushTable(PreConfig &pConfig){
 
-    int it_count = -1, hash_count = 0;
-    string Line;
-    while(getline(iErro,Line)) {
-        it_count++;
+    std::string plotname = pConfig.plotfile + "/" + pConfig.plotfile;
+    plotname += (pConfig.tableFormat == 1) ? ".json" : ".csv";
 
-        if (it_count == 0) {
-            continue;
-        }
-        hash_count++;
-        if (Line.find("#") != string::npos) hash_count = 0;
-
-        FillLegend(table,hash_count,it_count);
-
-        if(hash_count == 0) table <<"\n";
-        else table << Line << "\n";
-    }
-}
+    ofstream table(plotname.c_str());
+    table.precision(10);
 
-void FillLegend(ofstream &table,int hash_count,int it_count){
-    switch (hash_count) {
-        case (0):
-            table << "\n";
-            break;
-        case (1):
-            table << "semiH1-error" << ",";
-            break;
-        case (2):
-            table << "L2-error" << ",";
-            break;
-        case (3):
-            table << "3rd-error" << ",";
-            break;
-        case (4):
-            if (it_count == 5)
-                table << "h" << ",";
-            else
-                table << "semiH1-rate" << ",";
-            break;
-        case (5):
-            if (it_count == 6)
-                table << "DOF" << ",";
-            else
-                table << "L2-rate" << ",";
-            break;
-        case (6):
-            table << "3rd-rate" << ",";
-            break;
-        case (7):
-            table << "h" << ",";
+    switch(pConfig.tableFormat) {
+        case 0:
+            WriteCsvTable(pConfig, table);
             break;
-        case (8):
-            table << "DOF" << ",";
+        case 1:
+            WriteJsonTable(pConfig, table);
             break;
         default:
+            std::cout << "Invalid table format";
+            DebugStop();
             break;
     }
 }
-
-void CleanErrors(string file){
-    std::ifstream iErro(file);
-    std::ofstream temp("temp.txt");
-    size_t last_index;
-    string Line, residue, other = "other";
-
-
-    int counter = -1;
-    while (getline(iErro, Line)) {
-        size_t found = Line.find(other);
-        if (found != string::npos) continue;
-
-        last_index = Line.find("=");
-
-        if (last_index == string::npos) {
-            last_index = Line.find(":");
-            if(last_index == string::npos)
-                temp << Line << endl;
-            else{
-                residue = Line.substr(last_index+2);
-                temp << residue <<endl;
-            }
-        }
-        else {
-            residue = Line.substr(last_index+2);
-            temp << residue <<endl;
-        }
-    }
-    iErro.close(); temp.close();
-    remove(file.c_str());
-    rename("temp.txt", file.c_str());
-}
\ No newline at end of file
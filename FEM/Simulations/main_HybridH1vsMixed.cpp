@@ -23,32 +23,33 @@ int main(int argc, char *argv[]) {
     pConfig.n = 3;
     pConfig.problem = "ESteklovNonConst";        //// {"Esinsin","EArcTan",ESteklovNonConst"}
     pConfig.approx = "Hybrid";                    //// {"H1","Hybrid", "Mixed"}
+    pConfig.solver = "default";                  //// {"default","skyline","frontal","sparse","pcg" (H1),"gmres"}, argv[5]
+    pConfig.preconditioner = "default";          //// pcg and gmres: {"default","element","jacobi"}
+    pConfig.cgTolerance = 1.e-10;
+    pConfig.keepCondensedMatrices = false;       //// Avoid recondensing every element when loading the solution
+    pConfig.snapshotDir = "";                    //// Store the Hybrid and Mixed meshes here and read them on later runs
+    pConfig.checkpointDir = "";                  //// Save each solved level here; a rerun resumes at the first missing one
+    pConfig.reuseStructure = false;              //// Batch only: share sparsity patterns of equal meshes between cases
+    //pConfig.rhsVariants.Push("EArcTan");       //// Other right hand sides solved with the same factorization
     pConfig.refLevel = 3;                        //// How many refinements
     pConfig.debugger = false;                    //// Print geometric and computational mesh
+    pConfig.validateSymmetry = false;            //// Count element matrices which are not symmetric
+    pConfig.parallelSweep = false;               //// Solve all refinement levels concurrently
+    pConfig.threads.assemble = 0;                //// Threads of the assembly; 0 = serial
+    pConfig.threads.factorize = 0;               //// MKL threads of the factorization; 0 = MKL default (1 per concurrent level or case)
+    pConfig.threads.error = 0;                   //// Threads of the error integration; 0 = serial
+    pConfig.threads.mesh = 0;                    //// Threads of the hybrid mesh searches and grouping; 0 = serial
+    pConfig.threads.sweep = 0;                   //// Levels or batch cases solved at once; 0 = all cores
+
+    if(IsBatchEntry(argc,argv)){                 //// --batch <file> or --batch <problems> <approxs> <k range> <n range>
+        TPZStack<BatchCase> cases;
+        ReadBatchEntry(argc,argv,pConfig,cases);
+        RunBatch(cases,pConfig);
+        return 0;
+    }
 
     EvaluateEntry(argc,argv,pConfig);
-    InitializeOutstream(pConfig,argv);
-
-    for (int ndiv = 1; ndiv < pConfig.refLevel+1; ndiv++) {     //ndiv = 1 corresponds to a 2x2 mesh.
-        pConfig.h = 1./pConfig.exp;
-        ProblemConfig config;
-        Configure(config,ndiv,pConfig,argv);
-
-        Solve(config,pConfig);
-
-        pConfig.hLog = pConfig.h;
-        pConfig.exp *=2;
-    }
-    std::string command = "cp Erro.txt " + pConfig.plotfile + "/Erro.txt";
-    system(command.c_str());
-    FlushTable(pConfig,argv);
+    RunStudy(pConfig);
 
     return 0.;
 }
-
-
-
-
-
-
-
@@ -10,48 +10,813 @@
 #include "TPZCompMeshTools.h"
 #include "TPZCreateMultiphysicsSpace.h"
 #include "TPZSSpStructMatrix.h"
-#include "TPZSSpStructMatrix.h"
+#include "TPZSpStructMatrix.h"
 #include "TPZParFrontStructMatrix.h"
 #include "pzskylstrmatrix.h"
+#include "pzskylmat.h"
+#include "pzsysmp.h"
+#include "pzysmp.h"
 #include "pzstepsolver.h"
+#include "pzbndcond.h"
+#include "pzcondensedcompel.h"
+#include "pzelementgroup.h"
+#include "pzelmat.h"
 #include "Tools.h"
 #include "Output.h"
+#include "InputTreatment.h"
+#include "TPZScopedTimer.h"
+#include "TPZGeoMeshHierarchy.h"
+#include "TPZMemoryUsage.h"
+#include "MeshSnapshot.h"
+#ifdef USING_MKL
+#include <mkl.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+//// Meshes of one refinement level
+//// Members are destroyed in reverse order of declaration: the multiphysics mesh goes first,
+//// then the meshes it was built upon and finally the geometric mesh they all reference
+struct LevelMeshes{
+    std::unique_ptr<TPZGeoMesh> gmesh;
+    std::vector<std::unique_ptr<TPZCompMesh> > atomic;
+    std::unique_ptr<TPZCompMesh> cmesh;
+    std::unique_ptr<TPZMultiphysicsCompMesh> multiCmesh;
+
+    //// Continuous H1 mesh, built on the first call
+    TPZCompMesh *H1Mesh(ProblemConfig &config, PreConfig &preConfig){
+        if (!cmesh) cmesh.reset(InsertCMeshH1(config,preConfig));
+        return cmesh.get();
+    }
+
+    //// Empty multiphysics mesh, allocated on the first call
+    TPZMultiphysicsCompMesh *MultiphysicsMesh(ProblemConfig &config){
+        if (!multiCmesh) multiCmesh.reset(new TPZMultiphysicsCompMesh(config.gmesh));
+        return multiCmesh.get();
+    }
+
+    //// Take ownership of the atomic meshes, which TPZMultiphysicsCompMesh does not delete
+    void AdoptAtomicMeshes(){
+        for (auto mesh : multiCmesh->MeshVector()) {
+            if (mesh) atomic.emplace_back(mesh);
+        }
+    }
+
+    //// Replace the meshes by those of a snapshot; false if there is none
+    //// A snapshot holds no material objects of the multiphysics mesh, the caller inserts them again
+    //// keepMatrix is not part of the snapshot key, it is applied again to the condensed elements
+    bool Restore(const std::string &snapshot, ProblemConfig &config, bool keepMatrix){
+        int64_t neq = 0;
+        TPZMultiphysicsCompMesh *restored = ReadMeshSnapshot(snapshot, neq);
+        if (!restored) return false;
+        if (restored->MaterialVec().size()) DebugStop();
+        multiCmesh.reset(restored);
+        gmesh.reset(restored->Reference());
+        config.gmesh = restored->Reference();
+
+        for (auto cel : restored->ElementVec()) {
+            TPZCondensedCompEl *condensed = dynamic_cast<TPZCondensedCompEl *>(cel);
+            if (condensed) condensed->SetKeepMatrix(keepMatrix);
+        }
+        restored->LoadReferences();
+        restored->InitializeBlock();
+        restored->ComputeNodElCon();
+        if (restored->NEquations() != neq) {
+            std::cout << "The mesh snapshot " << snapshot << " has " << restored->NEquations()
+                      << " equations, " << neq << " were written" << std::endl;
+            DebugStop();
+        }
+        return true;
+    }
+};
 
-void Solve(ProblemConfig &config, PreConfig &preConfig){
+//// Type of the hybrid space of hybridLevel (1 = hybrid, 2 = hybrid squared)
+static TPZCreateMultiphysicsSpace::MSpaceType HybridSpaceType(int hybridLevel){
+    if(hybridLevel == 2) return TPZCreateMultiphysicsSpace::EH1HybridSquared;
+    if(hybridLevel != 1) DebugStop();
+    return TPZCreateMultiphysicsSpace::EH1Hybrid;
+}
+
+//// Material ids and options of the hybrid space builder, the peripheral ids follow from the leaf mesh
+static void SetupHybridSpace(TPZCreateMultiphysicsSpace &createspace, PreConfig &pConfig){
+    createspace.SetMaterialIds({1,2,3}, {-6,-5,-2,-1});
+    createspace.fH1Hybrid.fHybridizeBCLevel = 1;//opcao de hibridizar o contorno
+    createspace.fH1Hybrid.fKeepCondensedMatrices = pConfig.keepCondensedMatrices;
+    createspace.SetNumThreads(pConfig.threads.mesh);
+    createspace.ComputePeriferalMaterialIds();
+}
+
+//// Take the hybrid meshes of the level from its snapshot, false if there is none
+static bool RestoreHybridH1ComputationalMesh(LevelMeshes &meshes, const std::string &snapshot, int &interFaceMatID, PreConfig &pConfig, ProblemConfig &config, int hybridLevel, LevelResult &level){
+    TPZScopedTimer timer(level.phaseTime[EMeshCreation], level.phaseCpu[EMeshCreation]);
+    // the leaf mesh has no wrap elements yet, so the material ids come out as when the snapshot was built
+    TPZCreateMultiphysicsSpace createspace(config.gmesh, HybridSpaceType(hybridLevel));
+    SetupHybridSpace(createspace, pConfig);
+    if(!meshes.Restore(snapshot, config, pConfig.keepCondensedMatrices)) return false;
+
+    TPZMultiphysicsCompMesh *cmesh = meshes.multiCmesh.get();
+    InsertMaterialHybrid(cmesh, config, pConfig);
+    createspace.InsertPeriferalMaterialObjects(cmesh);
+    createspace.InsertLagranceMaterialObjects(cmesh);
+    interFaceMatID = createspace.fH1Hybrid.fLagrangeMatid.first;
+    return true;
+}
+
+//// Take the mixed meshes of the level from its snapshot, false if there is none
+static bool RestoreMixedComputationalMesh(LevelMeshes &meshes, const std::string &snapshot, PreConfig &pConfig, ProblemConfig &config, LevelResult &level){
+    TPZScopedTimer timer(level.phaseTime[EMeshCreation], level.phaseCpu[EMeshCreation]);
+    if(!meshes.Restore(snapshot, config, pConfig.keepCondensedMatrices)) return false;
+    InsertMaterialMixed(meshes.multiCmesh.get(), config, pConfig);
+    return true;
+}
+
+//// Number of elements of symmetric materials whose element matrix is not symmetric
+//// Condensed elements and element groups are checked through the elements they contain
+static int64_t CountNonSymmetricElements(TPZCompMesh *cmesh){
+    int64_t count = 0;
+    std::function<void(TPZCompEl *)> check = [&](TPZCompEl *cel){
+        if(!cel) return;
+        TPZCondensedCompEl *condensed = dynamic_cast<TPZCondensedCompEl *>(cel);
+        if(condensed) return check(condensed->ReferenceCompEl());
+        TPZElementGroup *group = dynamic_cast<TPZElementGroup *>(cel);
+        if(group) {
+            for (auto sub : group->GetElGroup()) check(sub);
+            return;
+        }
+        TPZMaterial *mat = cel->Material();
+        if(!mat || !mat->IsSymetric()) return;
+        TPZElementMatrix ek(cmesh, TPZElementMatrix::EK), ef(cmesh, TPZElementMatrix::EF);
+        cel->CalcStiff(ek, ef);
+        if(!ek.fMat.VerifySymmetry(1.e-10)) count++;
+    };
+    for (auto cel : cmesh->ElementVec()) check(cel);
+    return count;
+}
 
-    TPZCompMesh *cmesh = InsertCMeshH1(config,preConfig);
-    TPZMultiphysicsCompMesh *multiCmesh = new TPZMultiphysicsCompMesh(config.gmesh);
+void Solve(ProblemConfig &config, PreConfig &preConfig, LevelResult &level){
+
+    // the level owns its geometric mesh, all its meshes are released when it is solved
+    LevelMeshes meshes;
+    meshes.gmesh.reset(config.gmesh);
+
+    for (int iphase = 0; iphase < ENumPhases; iphase++) level.phaseTime[iphase] = level.phaseCpu[iphase] = 0.;
+    level.time = 0.;
+    // the high-water mark is process wide, it only belongs to this level when nothing else runs
+    bool ownPeak = !preConfig.concurrentLevels && TPZMemoryUsage::ResetPeakRSS();
+    TPZScopedTimer total(level.time);
+
+    // only the spaces of the selected approximation are built
+    TPZCompMesh *cmesh = 0;
+    TPZMultiphysicsCompMesh *multiCmesh = 0;
+    {
+        TPZScopedTimer timer(level.phaseTime[EMeshCreation], level.phaseCpu[EMeshCreation]);
+        if(preConfig.mode == 0) cmesh = meshes.H1Mesh(config,preConfig);
+        else multiCmesh = meshes.MultiphysicsMesh(config);
+    }
     int interfaceMatID = -10;
     int hybridLevel = 1;
 
-    const clock_t start = clock();
-
     switch(preConfig.mode){
         case 0: //H1
-            TPZCompMeshTools::CreatedCondensedElements(cmesh, false, false);
-            SolveH1Problem(cmesh, config, preConfig);
+        {
+            TPZScopedTimer timer(level.phaseTime[ECondensation], level.phaseCpu[ECondensation]);
+            TPZCompMeshTools::CreatedCondensedElements(cmesh, false, preConfig.keepCondensedMatrices);
+        }
+            SolveH1Problem(cmesh, config, preConfig, level);
             break;
         case 1: //Hybrid
-            CreateHybridH1ComputationalMesh(multiCmesh, interfaceMatID,preConfig, config,hybridLevel);
-            SolveHybridH1Problem(multiCmesh, interfaceMatID, config, preConfig,hybridLevel);
+        {
+            std::string snapshot = SnapshotFile(preConfig, config.ndivisions, hybridLevel);
+            if(!RestoreHybridH1ComputationalMesh(meshes, snapshot, interfaceMatID, preConfig, config, hybridLevel, level)) {
+                CreateHybridH1ComputationalMesh(multiCmesh, interfaceMatID,preConfig, config,hybridLevel,level);
+                WriteMeshSnapshot(snapshot, multiCmesh);
+            }
+            multiCmesh = meshes.multiCmesh.get();
+            meshes.AdoptAtomicMeshes();
+            SolveHybridH1Problem(multiCmesh, interfaceMatID, config, preConfig, level,hybridLevel);
             break;
+        }
         case 2: //Mixed
-            CreateMixedComputationalMesh(multiCmesh, preConfig, config);
-            SolveMixedProblem(multiCmesh, config, preConfig);
+        {
+            std::string snapshot = SnapshotFile(preConfig, config.ndivisions, hybridLevel);
+            if(!RestoreMixedComputationalMesh(meshes, snapshot, preConfig, config, level)) {
+                CreateMixedComputationalMesh(multiCmesh, preConfig, config,level);
+                WriteMeshSnapshot(snapshot, multiCmesh);
+            }
+            multiCmesh = meshes.multiCmesh.get();
+            meshes.AdoptAtomicMeshes();
+            SolveMixedProblem(multiCmesh, config, preConfig, level);
             break;
+        }
         default:
             DebugStop();
             break;
     }
-    FlushTime(preConfig,start);
 
-    if(preConfig.debugger) DrawMesh(config,preConfig,cmesh,multiCmesh);
+    if(preConfig.validateSymmetry) {
+        // the check recomputes every element matrix, it is a diagnostic and not part of the level time
+        REAL validation = 0.;
+        {
+            TPZScopedTimer timer(validation);
+            int64_t count = CountNonSymmetricElements(preConfig.mode == 0 ? cmesh : multiCmesh);
+            std::cout << "Non symmetric element matrices: " << count << std::endl;
+        }
+        level.time -= validation;
+    }
+
+    if(preConfig.debugger) {
+        TPZScopedTimer timer(level.phaseTime[EPostProcessing], level.phaseCpu[EPostProcessing]);
+        DrawMesh(config,preConfig,level,cmesh,multiCmesh);
+    }
+
+    // the solution is saved while its mesh exists, the rows of the level are saved by RunStudy once complete
+    std::string checkpoint = CheckpointFile(preConfig, config.ndivisions);
+    if(!checkpoint.empty()) {
+        REAL writing = 0.;
+        {
+            TPZScopedTimer timer(writing);
+            WriteCheckpointSolution(checkpoint, preConfig.mode == 0 ? cmesh : multiCmesh);
+        }
+        level.time -= writing;
+    }
+
+    level.memory = TPZMemoryUsage::CurrentRSS();
+    level.peakMemory = ownPeak ? TPZMemoryUsage::PeakRSS() : -1.;
+    config.gmesh = 0;
+}
+
+//// Structural matrices which may be selected by name through PreConfig::solver
+typedef std::function<TPZStructMatrix *(TPZCompMesh *)> StructMatrixFactory;
+
+//// Factory of a solver and whether it needs a positive definite system
+//// The condensed Hybrid and Mixed systems are symmetric indefinite (saddle point), only LDLt solvers handle them
+struct SolverEntry{
+    StructMatrixFactory factory;
+    bool definiteOnly;
+};
+
+static const std::map<std::string, SolverEntry> &SolverRegistry(){
+    static const std::map<std::string, SolverEntry> registry = {
+        {"skyline", {[](TPZCompMesh *cmesh) -> TPZStructMatrix * {
+            return new TPZSkylineStructMatrix(cmesh);}, false}},
+        {"frontal", {[](TPZCompMesh *cmesh) -> TPZStructMatrix * {
+            return new TPZParFrontStructMatrix<TPZFrontSym<STATE> >(cmesh);}, false}},
+#ifdef USING_MKL
+        {"sparse", {[](TPZCompMesh *cmesh) -> TPZStructMatrix * {
+            return new TPZSymetricSpStructMatrix(cmesh);}, false}},
+#endif
+        // preconditioned conjugate gradient and restarted GMRES, see AssembleAndSolve
+        {"pcg", {[](TPZCompMesh *cmesh) -> TPZStructMatrix * {
+            return new TPZSpStructMatrix(cmesh);}, true}},
+        {"gmres", {[](TPZCompMesh *cmesh) -> TPZStructMatrix * {
+            return new TPZSpStructMatrix(cmesh);}, false}}
+    };
+    return registry;
+}
+
+bool HasSolver(const std::string &name, const std::string &approx){
+    if(name == "default") return true;
+    auto entry = SolverRegistry().find(name);
+    if(entry == SolverRegistry().end()) return false;
+    return approx == "H1" || !entry->second.definiteOnly;
 }
 
-void DrawMesh(ProblemConfig &config, PreConfig &preConfig, TPZCompMesh *cmesh, TPZMultiphysicsCompMesh *multiCmesh) {
+//// Solver used when none is chosen: sparse with MKL, otherwise frontal for H1 and skyline for Hybrid and Mixed
+//// Right hand side variants need a matrix which is factorized after the assembly, frontal is not used for them
+static std::string SolverName(PreConfig &pConfig){
+    if(pConfig.solver != "default") return pConfig.solver;
+#ifdef USING_MKL
+    return "sparse";
+#else
+    return (pConfig.mode == 0 && !pConfig.rhsVariants.size()) ? "frontal" : "skyline";
+#endif
+}
+
+//// Set on an the structural matrix selected in pConfig, restricted to matids when it is not empty
+//// The matrix is assembled with pConfig.threads.assemble threads
+static void SetupSolver(TPZAnalysis &an, TPZCompMesh *cmesh, PreConfig &pConfig, const std::set<int> &matids){
+
+    std::string name = SolverName(pConfig);
+    auto entry = SolverRegistry().find(name);
+    if(entry == SolverRegistry().end()){
+        std::cout << "Invalid solver " << name << "\n";
+        DebugStop();
+    }
+
+    if(!HasSolver(name, pConfig.approx)){
+        std::cout << "Solver " << name << " cannot solve the " << pConfig.approx << " system\n";
+        DebugStop();
+    }
+
+    TPZStructMatrix *strmat = entry->second.factory(cmesh);
+    strmat->SetNumThreads(pConfig.threads.assemble);
+    if(matids.size()) strmat->SetMaterialIds(matids);
+    an.SetStructuralMatrix(*strmat);
+    delete strmat;
+
+    // the matrix is assembled through a direct solver, an iterative one replaces it in AssembleAndSolve
+    TPZStepSolver<STATE> direct;
+    direct.SetDirect(ELDLt);
+    an.SetSolver(direct);
+}
+
+//// True for the Krylov solvers, which replace the factorization by a preconditioner
+static bool IsIterative(const std::string &name){
+    return name == "pcg" || name == "gmres";
+}
+
+//// Preconditioner of the Krylov solvers
+//// "element" gathers the equations of each condensed element in a block; for Hybrid these are the groups
+//// of GroupandCondenseElements. The default is the diagonal for pcg (H1) and the element blocks for gmres,
+//// whose saddle point systems may have zeros on the diagonal
+static TPZAnalysis::EPrecond Preconditioner(PreConfig &pConfig){
+    if(pConfig.preconditioner == "element") return TPZAnalysis::EElement;
+    if(pConfig.preconditioner == "jacobi") return TPZAnalysis::EJacobi;
+    if(pConfig.preconditioner != "default") {
+        std::cout << "Invalid preconditioner " << pConfig.preconditioner << "\n";
+        DebugStop();
+    }
+    return SolverName(pConfig) == "gmres" ? TPZAnalysis::EElement : TPZAnalysis::EJacobi;
+}
+
+//// Meshes which share their matrix structure: approximation, domain, k and n (n does not change the H1 mesh)
+typedef std::tuple<int, int, int, int> MeshFamily;
+
+static MeshFamily Family(int mode, int type, int k, int n){
+    return MeshFamily(mode, type == 2 ? 1 : 0, k, mode == 0 ? 0 : n);
+}
+
+//// Topology of an assembled system: mesh family, refinement level, solver and number of equations
+typedef std::tuple<MeshFamily, int, std::string, int64_t> StructureKey;
+
+//// Index arrays of an assembled matrix, enough to allocate an empty matrix of the same structure
+//// Skyline: fIA holds the height of each column; sparse: fIA and fJA are the compressed rows
+struct CachedStructure{
+    enum EKind {ESkyline, ESymSparse, ESparse} fKind = ESkyline;
+    TPZVec<int64_t> fIA, fJA;
+    /// studies of the process which will still assemble this structure
+    int fRemaining = 0;
+};
+
+//// Structures of the systems assembled so far, shared by the studies of a batch
+//// A mesh solved again (other exact solution or right hand side) starts from the cached sparsity pattern,
+//// so only the numeric assembly and factorization are repeated. An entry is dropped as soon as the last study
+//// of its family has used it, so the cache holds at most the levels of the families still running
+static std::map<StructureKey, CachedStructure> gStructureCache;
+//// Number of studies of each family the process will run, see RegisterStructureUses
+static std::map<MeshFamily, int> gFamilyUses;
+static std::mutex gStructureMutex;
+
+//// Mesh family of a batch case run with the settings of defaults
+static MeshFamily CaseFamily(const BatchCase &entry, const PreConfig &defaults){
+    PreConfig pConfig;
+    SetBatchCase(pConfig, defaults, entry);
+    return Family(pConfig.mode, pConfig.type, pConfig.k, pConfig.n);
+}
+
+//// Announce the studies of a batch, structures are only kept for families solved more than once
+static void RegisterStructureUses(const TPZVec<BatchCase> &cases, const PreConfig &defaults){
+    std::lock_guard<std::mutex> lock(gStructureMutex);
+    for (auto &entry : cases) gFamilyUses[CaseFamily(entry, defaults)]++;
+}
+
+//// Count a study which will not read the cached entry anymore, dropping the entry after its last reader
+//// gStructureMutex must be held
+static void ReleaseStructure(std::map<StructureKey, CachedStructure>::iterator entry){
+    if(--entry->second.fRemaining == 0) gStructureCache.erase(entry);
+}
+
+//// Give the solver of an an empty matrix with the cached structure of its topology, returns false if there is none
+static bool UseCachedStructure(TPZAnalysis &an, const StructureKey &key){
+    CachedStructure structure;
+    {
+        std::lock_guard<std::mutex> lock(gStructureMutex);
+        auto entry = gStructureCache.find(key);
+        if(entry == gStructureCache.end()) return false;
+        // the last study of the family takes the arrays instead of copying them
+        if(entry->second.fRemaining == 1) structure = std::move(entry->second);
+        else structure = entry->second;
+        ReleaseStructure(entry);
+    }
+
+    int64_t neq = std::get<3>(key);
+    TPZMatrix<STATE> *mat = 0;
+    switch(structure.fKind) {
+        case CachedStructure::ESkyline:
+            mat = new TPZSkylMatrix<STATE>(neq, structure.fIA);
+            break;
+        case CachedStructure::ESymSparse:
+        {
+            TPZSYsmpMatrix<STATE> *sparse = new TPZSYsmpMatrix<STATE>(neq, neq);
+            TPZVec<STATE> values(structure.fJA.size(), 0.);
+            sparse->SetData(structure.fIA, structure.fJA, values);
+            mat = sparse;
+            break;
+        }
+        case CachedStructure::ESparse:
+        {
+            TPZFYsmpMatrix<STATE> *sparse = new TPZFYsmpMatrix<STATE>(neq, neq);
+            TPZVec<STATE> values(structure.fJA.size(), 0.);
+            sparse->SetData(structure.fIA, structure.fJA, values);
+            mat = sparse;
+            break;
+        }
+    }
+    an.Solver().SetMatrix(TPZAutoPointer<TPZMatrix<STATE> >(mat));
+    return true;
+}
+
+//// Store the index arrays of the assembled, not yet decomposed, matrix of an if another study will need them
+//// A study which missed the cache while another one of its family was assembling the same level counts as one
+//// of the readers of the entry stored by the other, so that every entry is dropped once its family is done
+static void CacheStructure(TPZAnalysis &an, const StructureKey &key){
+    int remaining;
+    {
+        std::lock_guard<std::mutex> lock(gStructureMutex);
+        auto uses = gFamilyUses.find(std::get<0>(key));
+        remaining = uses == gFamilyUses.end() ? 0 : uses->second-1;
+        if(remaining < 1) return;
+        auto entry = gStructureCache.find(key);
+        if(entry != gStructureCache.end()) {
+            ReleaseStructure(entry);
+            return;
+        }
+    }
+
+    CachedStructure structure;
+    structure.fRemaining = remaining;
+    TPZMatrix<STATE> *mat = an.Solver().Matrix().operator->();
+    TPZVec<STATE> values;
+    if(TPZSkylMatrix<STATE> *skyline = dynamic_cast<TPZSkylMatrix<STATE> *>(mat)) {
+        structure.fKind = CachedStructure::ESkyline;
+        int64_t neq = skyline->Rows();
+        structure.fIA.Resize(neq);
+        for (int64_t ieq = 0; ieq < neq; ieq++) structure.fIA[ieq] = ieq - skyline->SkyHeight(ieq);
+    }
+    else if(TPZSYsmpMatrix<STATE> *sparse = dynamic_cast<TPZSYsmpMatrix<STATE> *>(mat)) {
+        structure.fKind = CachedStructure::ESymSparse;
+        sparse->GetData(structure.fIA, structure.fJA, values);
+    }
+    else if(TPZFYsmpMatrix<STATE> *sparse = dynamic_cast<TPZFYsmpMatrix<STATE> *>(mat)) {
+        structure.fKind = CachedStructure::ESparse;
+        sparse->GetData(structure.fIA, structure.fJA, values);
+    }
+    else return;
+
+    std::lock_guard<std::mutex> lock(gStructureMutex);
+    auto inserted = gStructureCache.emplace(key, std::move(structure));
+    if(!inserted.second) ReleaseStructure(inserted.first);
+}
+
+//// Assemble the matrix and right hand side of an, starting from a cached structure if one is available
+static void AssembleSystem(TPZAnalysis &an, PreConfig &pConfig, LevelResult &level){
+
+    // frontal matrices are decomposed while they are assembled and cannot be reused
+    bool reuse = pConfig.reuseStructure && SolverName(pConfig) != "frontal";
+    StructureKey key(Family(pConfig.mode, pConfig.type, pConfig.k, pConfig.n), level.ndiv, SolverName(pConfig), an.Mesh()->NEquations());
+    {
+        TPZScopedTimer timer(level.phaseTime[EAssembly], level.phaseCpu[EAssembly]);
+        bool cached = reuse && UseCachedStructure(an, key);
+        if(cached) std::cout << "Reusing the matrix structure of a previous run" << std::endl;
+        an.Assemble();
+        if(reuse && !cached) CacheStructure(an, key);
+    }
+}
+
+//// Assemble, factorize and back-substitute the system of an, timing each step separately
+//// For iterative solvers the preconditioner is built in place of the factorization
+static void AssembleAndSolve(TPZAnalysis &an, PreConfig &pConfig, LevelResult &level){
+
+    AssembleSystem(an, pConfig, level);
+
+#ifdef USING_MKL
+    // thread local, so that levels solved concurrently do not change each other's setting
+    mkl_set_num_threads_local(pConfig.threads.factorize);
+#endif
+
+    TPZAutoPointer<TPZMatrix<STATE> > mat = an.Solver().Matrix();
+    std::string name = SolverName(pConfig);
+    bool iterative = IsIterative(name);
+    if(iterative){
+        TPZMatrixSolver<STATE> *precond;
+        {
+            // the element blocks overlap on the connects shared by neighbouring groups
+            TPZScopedTimer timer(level.phaseTime[EFactorization], level.phaseCpu[EFactorization]);
+            bool overlap = true;
+            precond = an.BuildPreconditioner(Preconditioner(pConfig), overlap);
+        }
+        int64_t maxiterations = pConfig.cgMaxIterations > 0 ? pConfig.cgMaxIterations : mat->Rows();
+        TPZStepSolver<STATE> krylov(mat);
+        // CG needs a positive definite system (H1); GMRES also solves the indefinite Hybrid and Mixed systems
+        if(name == "pcg") krylov.SetCG(maxiterations, *precond, pConfig.cgTolerance, 0);
+        else krylov.SetGMRES(maxiterations, pConfig.gmresKrylov, *precond, pConfig.cgTolerance, 0);
+        an.SetSolver(krylov);
+        delete precond;
+    }
+    else {
+        // the frontal matrices are already decomposed by the assembly
+        TPZScopedTimer timer(level.phaseTime[EFactorization], level.phaseCpu[EFactorization]);
+        if(!mat->IsDecomposed()) mat->Decompose_LDLt();
+    }
+
+    {
+        TPZScopedTimer timer(level.phaseTime[EBackSubstitution], level.phaseCpu[EBackSubstitution]);
+        an.Solve();
+    }
+#ifdef USING_MKL
+    mkl_set_num_threads_local(0);
+#endif
+
+    if(iterative){
+        // the step solver returns the number of iterations performed and the relative residual reached
+        TPZStepSolver<STATE> *krylov = dynamic_cast<TPZStepSolver<STATE> *>(&an.Solver());
+        if(!krylov) DebugStop();
+        level.iterations = krylov->NumIterations();
+        level.residual = krylov->GetTolerance();
+        std::cout << name << ": " << level.iterations << " iterations, relative residual " << level.residual << std::endl;
+        // a solution which misses the tolerance would silently spoil the errors and rates of the study
+        if(!(level.residual <= pConfig.cgTolerance)){
+            std::cout << name << " did not reach the relative residual " << pConfig.cgTolerance << " in "
+                      << level.iterations << " iterations" << std::endl;
+            DebugStop();
+        }
+    }
+}
+
+//// Replace the source and boundary data of the materials of cmesh by those of exact
+static void SetExactSolution(TPZCompMesh *cmesh, TPZAutoPointer<TLaplaceExample1> &exact){
+    for (auto &entry : cmesh->MaterialVec()) {
+        TPZMaterial *mat = entry.second;
+        if (!mat->HasForcingFunction()) continue;
+        TPZBndCond *bc = dynamic_cast<TPZBndCond *>(mat);
+        // TPZBndCond hides the TPZMaterial overload taking a function
+        if (bc) bc->TPZMaterial::SetForcingFunction(exact->Exact());
+        else {
+            mat->SetForcingFunction(exact->ForcingFunction());
+            mat->SetForcingFunctionExact(exact->Exact());
+        }
+    }
+}
+
+//// Solve the problem of config and the right hand side variants of level with a single factorization
+//// The right hand sides are assembled as the columns of one matrix and substituted together,
+//// the errors of each variant are stored in its own row; the solution of config is left loaded in an
+static void AssembleAndSolveVariants(TPZAnalysis &an, ProblemConfig &config, PreConfig &pConfig, LevelResult &level){
+
+    TPZCompMesh *cmesh = an.Mesh();
+    int nrhs = level.variants.size()+1;
+    TPZVec<TPZAutoPointer<TLaplaceExample1> > exact(nrhs);
+    exact[0] = config.exact;
+    for (int irhs = 1; irhs < nrhs; irhs++) {
+        exact[irhs] = new TLaplaceExample1;
+        exact[irhs]->fExact = level.variants[irhs-1]->problem == "EArcTan" ? TLaplaceExample1::EArcTan : TLaplaceExample1::ESinSin;
+        exact[irhs]->fSignConvention = config.exact->fSignConvention;
+    }
+
+    AssembleSystem(an, pConfig, level);
+
+    TPZFMatrix<STATE> solutions(an.Rhs().Rows(), nrhs, 0.);
+    {
+        TPZScopedTimer timer(level.phaseTime[EAssembly], level.phaseCpu[EAssembly]);
+        for (int irhs = 0; irhs < nrhs; irhs++) {
+            if (irhs) {
+                SetExactSolution(cmesh, exact[irhs]);
+                an.AssembleResidual();
+            }
+            for (int64_t ieq = 0; ieq < solutions.Rows(); ieq++) solutions(ieq, irhs) = an.Rhs()(ieq, 0);
+        }
+    }
+
+#ifdef USING_MKL
+    mkl_set_num_threads_local(pConfig.threads.factorize);
+#endif
+    TPZAutoPointer<TPZMatrix<STATE> > mat = an.Solver().Matrix();
+    {
+        TPZScopedTimer timer(level.phaseTime[EFactorization], level.phaseCpu[EFactorization]);
+        if(!mat->IsDecomposed()) mat->Decompose_LDLt();
+    }
+    {
+        TPZScopedTimer timer(level.phaseTime[EBackSubstitution], level.phaseCpu[EBackSubstitution]);
+        mat->SolveDirect(solutions, ELDLt);
+    }
+#ifdef USING_MKL
+    mkl_set_num_threads_local(0);
+#endif
+
+    // the condensed elements recover their internal unknowns from the load vector of the last assembly,
+    // or recompute it when they do not keep their matrices, so each variant is loaded with its own data;
+    // the problem of config goes last
+    TPZFMatrix<STATE> solution(solutions.Rows(), 1);
+    for (int irhs = nrhs-1; irhs >= 0; irhs--) {
+        SetExactSolution(cmesh, exact[irhs]);
+        if (pConfig.keepCondensedMatrices && irhs != nrhs-1) {
+            TPZScopedTimer timer(level.phaseTime[EAssembly], level.phaseCpu[EAssembly]);
+            an.AssembleResidual();
+        }
+        for (int64_t ieq = 0; ieq < solutions.Rows(); ieq++) solution(ieq, 0) = solutions(ieq, irhs);
+        an.LoadSolution(solution);
+        if (!irhs) break;
+
+        LevelResult &variant = *level.variants[irhs-1];
+        an.SetExact(exact[irhs]->ExactSolution());
+        StockErrors(an, cmesh, variant, pConfig);
+    }
+}
+
+void SolveSweep(TPZVec<ProblemConfig> &configs, PreConfig &preConfig, TPZVec<LevelResult> &levels, int first){
+
+    int nlevels = configs.size();
+    int njobs = nlevels-first;
+    int nthreads = preConfig.threads.sweep;
+    if(nthreads < 1) nthreads = std::thread::hardware_concurrency();
+    nthreads = std::max(1, std::min(nthreads, njobs));
+    preConfig.concurrentLevels = nthreads > 1;
+    // MKL's default would give every concurrent level all the cores
+    if(preConfig.concurrentLevels && preConfig.threads.factorize < 1) preConfig.threads.factorize = 1;
+
+    // the finest levels are dispatched first so that the most expensive solve never starts last
+    std::atomic<int> next(0);
+    auto worker = [&](){
+        for(int job = next++; job < njobs; job = next++){
+            int ilevel = nlevels-1-job;
+            Solve(configs[ilevel], preConfig, levels[ilevel]);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(int ithread = 1; ithread < nthreads; ithread++) pool.emplace_back(worker);
+    worker();
+    for(auto &thread : pool) thread.join();
+}
+
+//// Table rows of a level: its own row followed by those of its right hand side variants
+static TPZVec<LevelResult *> LevelRows(LevelResult &level){
+    TPZVec<LevelResult *> rows(level.variants.size()+1);
+    rows[0] = &level;
+    for (int ivar = 0; ivar < level.variants.size(); ivar++) rows[ivar+1] = level.variants[ivar];
+    return rows;
+}
+
+void RunStudy(PreConfig &pConfig){
+
+    InitializeOutstream(pConfig);
+
+    // the levels are refined incrementally from a single geometric mesh
+    TPZGeoMeshHierarchy hierarchy(CreateCoarseGeoMesh(pConfig));
+    TPZVec<ProblemConfig> configs(pConfig.refLevel);
+    TPZVec<LevelResult> &levels = pConfig.results;
+
+    // one row per (right hand side, level): the levels of pConfig.problem come first, then those of each variant
+    int nvariants = pConfig.rhsVariants.size();
+    levels.Resize(pConfig.refLevel*(nvariants+1));
+    for (int ilevel = 0; ilevel < pConfig.refLevel; ilevel++) {
+        levels[ilevel].problem = pConfig.problem;
+        levels[ilevel].variants.Resize(nvariants);
+        for (int ivar = 0; ivar < nvariants; ivar++) {
+            LevelResult &variant = levels[(ivar+1)*pConfig.refLevel+ilevel];
+            variant.problem = pConfig.rhsVariants[ivar];
+            levels[ilevel].variants[ivar] = &variant;
+        }
+    }
+
+    // levels checkpointed by an earlier run of the study are read back, the sweep resumes at the first missing one
+    int nsaved = 0;
+    for (; nsaved < pConfig.refLevel; nsaved++) {
+        TPZVec<LevelResult *> rows = LevelRows(levels[nsaved]);
+        if(!ReadCheckpointRows(CheckpointFile(pConfig, nsaved+1), rows)) break;
+    }
+    if(nsaved) std::cout << "Resuming " << pConfig.plotfile << " after level " << nsaved << std::endl;
+
+    // the geometric refinement of each level is part of its mesh creation; Solve resets the times of the level,
+    // so they are added once it is solved
+    TPZVec<REAL> geometryTime(pConfig.refLevel, 0.), geometryCpu(pConfig.refLevel, 0.);
+    auto finish = [&](int ilevel){
+        levels[ilevel].phaseTime[EMeshCreation] += geometryTime[ilevel];
+        levels[ilevel].phaseCpu[EMeshCreation] += geometryCpu[ilevel];
+        levels[ilevel].time += geometryTime[ilevel];
+        WriteCheckpointRows(CheckpointFile(pConfig, ilevel+1), LevelRows(levels[ilevel]));
+    };
+    for (int ndiv = 1; ndiv < pConfig.refLevel+1; ndiv++) {     //ndiv = 1 corresponds to a 2x2 mesh.
+        pConfig.h = 1./pConfig.exp;
+        if(ndiv <= nsaved) {
+            // the hierarchy refines the saved levels again when the first missing one is configured
+            pConfig.exp *=2;
+            continue;
+        }
+        ProblemConfig &config = configs[ndiv-1];
+        {
+            TPZScopedTimer timer(geometryTime[ndiv-1], geometryCpu[ndiv-1]);
+            Configure(config,ndiv,pConfig,hierarchy);
+        }
+        levels[ndiv-1].ndiv = ndiv;
+        levels[ndiv-1].h = pConfig.h;
+        for (auto variant : levels[ndiv-1].variants) {
+            variant->ndiv = ndiv;
+            variant->h = pConfig.h;
+        }
+
+        if(!pConfig.parallelSweep) {
+            Solve(config,pConfig,levels[ndiv-1]);
+            finish(ndiv-1);
+        }
+
+        pConfig.exp *=2;
+    }
+    if(pConfig.parallelSweep && nsaved < pConfig.refLevel) {
+        SolveSweep(configs,pConfig,levels,nsaved);
+        for (int ilevel = nsaved; ilevel < pConfig.refLevel; ilevel++) finish(ilevel);
+    }
+    // the variant rows are referenced only while solving
+    for (auto &level : levels) level.variants.Resize(0);
+
+    ComputeRates(pConfig);
+    FlushTable(pConfig);
+}
+
+//// Rough cost of a case: number of pressure unknowns on its finest level
+static REAL EstimateCost(const BatchCase &entry, int refLevel){
+    int order = entry.k;
+    if(entry.approx != "H1") order += entry.n;
+    return pow(4.,refLevel)*(order+1)*(order+1);
+}
+
+//// Split the cases of a batch in jobs, each job is run by a single worker one case after the other
+//// With reuseStructure the cases of a mesh family form one job: run concurrently they would all miss the cache
+static void BatchJobs(const TPZVec<BatchCase> &cases, const PreConfig &defaults, std::vector<std::vector<int> > &jobs){
+    std::map<MeshFamily, int> familyJob;
+    for(int icase = 0; icase < cases.size(); icase++){
+        if(!defaults.reuseStructure) {
+            jobs.push_back({icase});
+            continue;
+        }
+        MeshFamily family = CaseFamily(cases[icase], defaults);
+        auto found = familyJob.find(family);
+        if(found != familyJob.end()) {
+            jobs[found->second].push_back(icase);
+            continue;
+        }
+        familyJob[family] = jobs.size();
+        jobs.push_back({icase});
+    }
+}
+
+void RunBatch(TPZVec<BatchCase> &cases, const PreConfig &defaults){
+
+    // the thread budget of threads.sweep is spent on the cases, nesting a level pool would oversubscribe it
+    if(defaults.parallelSweep) std::cout << "parallelSweep is ignored in a batch, the cases are solved concurrently" << std::endl;
+
+    // refinement patterns are shared by all cases, they are created before the workers start
+    gRefDBase.InitializeUniformRefPattern(EOned);
+    gRefDBase.InitializeUniformRefPattern(EQuadrilateral);
+
+    if(defaults.reuseStructure) RegisterStructureUses(cases, defaults);
+
+    std::vector<std::vector<int> > jobs;
+    BatchJobs(cases, defaults, jobs);
+    int njobs = jobs.size();
+    std::vector<REAL> cost(njobs, 0.);
+    for(int job = 0; job < njobs; job++)
+        for(int icase : jobs[job]) cost[job] += EstimateCost(cases[icase], defaults.refLevel);
+    std::vector<int> order(njobs);
+    for(int job = 0; job < njobs; job++) order[job] = job;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b){ return cost[a] > cost[b]; });
+
+    int nthreads = defaults.threads.sweep;
+    if(nthreads < 1) nthreads = std::thread::hardware_concurrency();
+    nthreads = std::max(1, std::min(nthreads, njobs));
+    PreConfig batch = defaults;
+    batch.concurrentLevels = nthreads > 1;
+    // MKL's default would give every concurrent case all the cores
+    if(batch.concurrentLevels && batch.threads.factorize < 1) batch.threads.factorize = 1;
+
+    std::atomic<int> next(0);
+    auto worker = [&](){
+        for(int job = next++; job < njobs; job = next++){
+            for(int icase : jobs[order[job]]){
+                PreConfig pConfig;
+                SetBatchCase(pConfig, batch, cases[icase]);
+                RunStudy(pConfig);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(int ithread = 1; ithread < nthreads; ithread++) pool.emplace_back(worker);
+    worker();
+    for(auto &thread : pool) thread.join();
+}
+
+void DrawMesh(ProblemConfig &config, PreConfig &preConfig, LevelResult &level, TPZCompMesh *cmesh, TPZMultiphysicsCompMesh *multiCmesh) {
 
     std::stringstream ref;
-    ref << "_ref-" << 1/preConfig.h <<" x " << 1/preConfig.h;
+    ref << "_ref-" << 1/level.h <<" x " << 1/level.h;
     std::string refinement =  ref.str();
 
     std::ofstream out(preConfig.plotfile + "/gmesh"+ refinement + ".vtk");
@@ -65,73 +830,83 @@ void DrawMesh(ProblemConfig &config, PreConfig &preConfig, TPZCompMesh *cmesh, T
     else multiCmesh->Print(out3);
 }
 
-void CreateMixedComputationalMesh(TPZMultiphysicsCompMesh *cmesh_Mixed, PreConfig &pConfig, ProblemConfig &config){
+void CreateMixedComputationalMesh(TPZMultiphysicsCompMesh *cmesh_Mixed, PreConfig &pConfig, ProblemConfig &config, LevelResult &level){
 
     int matID = 1;
     int dim = config.gmesh->Dimension();
 
-    //Flux mesh creation
-    TPZCompMesh *cmesh_flux = new TPZCompMesh(config.gmesh);
-    BuildFluxMesh(cmesh_flux, config,pConfig);
-
-    //Potential mesh creation
-    TPZCompMesh *cmesh_p = new TPZCompMesh(config.gmesh);
-    BuildPotentialMesh(cmesh_p, config, pConfig);
-
-    //Multiphysics mesh build
-    InsertMaterialMixed(cmesh_Mixed, config,pConfig);
-    TPZManVector<int> active(2, 1);
     TPZManVector<TPZCompMesh *, 2> meshvector(2);
-    meshvector[0] = cmesh_flux;
-    meshvector[1] = cmesh_p;
-    TPZCompMeshTools::AdjustFluxPolynomialOrders(meshvector[0], config.n); //Increases internal flux order by "hdivmais"
-    TPZCompMeshTools::SetPressureOrders(meshvector[0], meshvector[1]);//Set the pressure order the same as the internal flux
+    {
+        TPZScopedTimer timer(level.phaseTime[EAtomicMeshes], level.phaseCpu[EAtomicMeshes]);
+        //Flux mesh creation
+        TPZCompMesh *cmesh_flux = new TPZCompMesh(config.gmesh);
+        BuildFluxMesh(cmesh_flux, config,pConfig);
+
+        //Potential mesh creation
+        TPZCompMesh *cmesh_p = new TPZCompMesh(config.gmesh);
+        BuildPotentialMesh(cmesh_p, config, pConfig);
+
+        meshvector[0] = cmesh_flux;
+        meshvector[1] = cmesh_p;
+        TPZCompMeshTools::AdjustFluxPolynomialOrders(meshvector[0], config.n); //Increases internal flux order by "hdivmais"
+        TPZCompMeshTools::SetPressureOrders(meshvector[0], meshvector[1]);//Set the pressure order the same as the internal flux
+    }
+
+    {
+        TPZScopedTimer timer(level.phaseTime[EMeshCreation], level.phaseCpu[EMeshCreation]);
+        //Multiphysics mesh build
+        InsertMaterialMixed(cmesh_Mixed, config,pConfig);
+        TPZManVector<int> active(2, 1);
+        cmesh_Mixed->BuildMultiphysicsSpace(active,meshvector);
+    }
 
-    cmesh_Mixed->BuildMultiphysicsSpace(active,meshvector);
-    bool keeponelagrangian = true, keepmatrix = false;
+    TPZScopedTimer timer(level.phaseTime[ECondensation], level.phaseCpu[ECondensation]);
+    bool keeponelagrangian = true, keepmatrix = pConfig.keepCondensedMatrices;
     TPZCompMeshTools::CreatedCondensedElements(cmesh_Mixed, keeponelagrangian, keepmatrix);
     cmesh_Mixed->LoadReferences();
     cmesh_Mixed->InitializeBlock();
 }
 
-void CreateHybridH1ComputationalMesh(TPZMultiphysicsCompMesh *cmesh_H1Hybrid,int &interFaceMatID , PreConfig &pConfig, ProblemConfig &config,int hybridLevel){
-    auto spaceType = TPZCreateMultiphysicsSpace::EH1Hybrid;
-    if(hybridLevel == 2) {
-        spaceType = TPZCreateMultiphysicsSpace::EH1HybridSquared;
-    }
-    else if(hybridLevel != 1) {
-        DebugStop();
-    }
-
-    TPZCreateMultiphysicsSpace createspace(config.gmesh, spaceType);
+void CreateHybridH1ComputationalMesh(TPZMultiphysicsCompMesh *cmesh_H1Hybrid,int &interFaceMatID , PreConfig &pConfig, ProblemConfig &config,int hybridLevel, LevelResult &level){
+    TPZCreateMultiphysicsSpace createspace(config.gmesh, HybridSpaceType(hybridLevel));
     //TPZCreateMultiphysicsSpace createspace(config.gmesh);
     std::cout << cmesh_H1Hybrid->NEquations();
 
-    createspace.SetMaterialIds({1,2,3}, {-6,-5,-2,-1});
-    createspace.fH1Hybrid.fHybridizeBCLevel = 1;//opcao de hibridizar o contorno
-    createspace.ComputePeriferalMaterialIds();
+    SetupHybridSpace(createspace, pConfig);
 
     TPZManVector<TPZCompMesh *> meshvec;
 
     int pOrder = config.n+config.k;
-    createspace.CreateAtomicMeshes(meshvec,pOrder,config.k);
+    {
+        TPZScopedTimer timer(level.phaseTime[EAtomicMeshes], level.phaseCpu[EAtomicMeshes]);
+        createspace.CreateAtomicMeshes(meshvec,pOrder,config.k);
+    }
 
-    InsertMaterialHybrid(cmesh_H1Hybrid, config,pConfig);
-    createspace.InsertPeriferalMaterialObjects(cmesh_H1Hybrid);
-    cmesh_H1Hybrid->BuildMultiphysicsSpace(meshvec);
-    createspace.InsertLagranceMaterialObjects(cmesh_H1Hybrid);
+    {
+        TPZScopedTimer timer(level.phaseTime[EMeshCreation], level.phaseCpu[EMeshCreation]);
+        InsertMaterialHybrid(cmesh_H1Hybrid, config,pConfig);
+        createspace.InsertPeriferalMaterialObjects(cmesh_H1Hybrid);
+        cmesh_H1Hybrid->BuildMultiphysicsSpace(meshvec);
+        createspace.InsertLagranceMaterialObjects(cmesh_H1Hybrid);
+    }
 
-    createspace.AddInterfaceElements(cmesh_H1Hybrid);
-    createspace.GroupandCondenseElements(cmesh_H1Hybrid);
+    {
+        TPZScopedTimer timer(level.phaseTime[EInterfaces], level.phaseCpu[EInterfaces]);
+        createspace.AddInterfaceElements(cmesh_H1Hybrid);
+    }
+    {
+        TPZScopedTimer timer(level.phaseTime[ECondensation], level.phaseCpu[ECondensation]);
+        createspace.GroupandCondenseElements(cmesh_H1Hybrid);
 
-    cmesh_H1Hybrid->InitializeBlock();
-    cmesh_H1Hybrid->ComputeNodElCon();
+        cmesh_H1Hybrid->InitializeBlock();
+        cmesh_H1Hybrid->ComputeNodElCon();
+    }
 
     interFaceMatID = createspace.fH1Hybrid.fLagrangeMatid.first;
 
 }
 
-void SolveH1Problem(TPZCompMesh *cmeshH1,struct ProblemConfig &config, struct PreConfig &pConfig){
+void SolveH1Problem(TPZCompMesh *cmeshH1,struct ProblemConfig &config, struct PreConfig &pConfig, LevelResult &level){
 
     config.exact.operator*().fSignConvention = -1;
 
@@ -139,17 +914,6 @@ void SolveH1Problem(TPZCompMesh *cmeshH1,struct ProblemConfig &config, struct Pr
 
     TPZAnalysis an(cmeshH1);
 
-#ifdef USING_MKL
-    TPZSymetricSpStructMatrix strmat(cmeshH1);
-    strmat.SetNumThreads(8);
-    //        strmat.SetDecomposeType(ELDLt);
-#else
-    TPZParFrontStructMatrix<TPZFrontSym<STATE> > strmat(cmeshH1);
-    strmat.SetNumThreads(0);
-    //        TPZSkylineStructMatrix strmat3(cmesh_HDiv);
-    //        strmat3.SetNumThreads(8);
-#endif
-
     std::set<int> matids;
     for (auto matid : config.materialids) matids.insert(matid);
 
@@ -157,31 +921,28 @@ void SolveH1Problem(TPZCompMesh *cmeshH1,struct ProblemConfig &config, struct Pr
         matids.insert(mat);
     }
 
-    strmat.SetMaterialIds(matids);
-    an.SetStructuralMatrix(strmat);
-
-    TPZStepSolver<STATE> *direct = new TPZStepSolver<STATE>;
-    direct->SetDirect(ELDLt);
-    an.SetSolver(*direct);
-    delete direct;
-    direct = 0;
-    an.Assemble();
-    an.Solve();//resolve o problema misto ate aqui
+    SetupSolver(an, cmeshH1, pConfig, matids);
+    if(level.variants.size()) AssembleAndSolveVariants(an,config,pConfig,level);
+    else AssembleAndSolve(an,pConfig,level);//resolve o problema misto ate aqui
 
-    int64_t nelem = cmeshH1->NElements();
-    cmeshH1->LoadSolution(cmeshH1->Solution());
-    cmeshH1->ExpandSolution();
-    cmeshH1->ElementSolution().Redim(nelem, 10);
+    {
+        TPZScopedTimer timer(level.phaseTime[EBackSubstitution], level.phaseCpu[EBackSubstitution]);
+        int64_t nelem = cmeshH1->NElements();
+        cmeshH1->LoadSolution(cmeshH1->Solution());
+        cmeshH1->ExpandSolution();
+        cmeshH1->ElementSolution().Redim(nelem, 10);
+    }
 
     ////Calculo do erro
     std::cout << "Computing Error H1 " << std::endl;
 
     an.SetExact(config.exact.operator*().ExactSolution());
 
-    StockErrorsH1(an,cmeshH1,pConfig.Erro,pConfig.Log,pConfig);
+    StockErrors(an,cmeshH1,level,pConfig);
 
     ////PostProcess
     if(pConfig.debugger) {
+        TPZScopedTimer timer(level.phaseTime[EPostProcessing], level.phaseCpu[EPostProcessing]);
         TPZStack<std::string> scalnames, vecnames;
         scalnames.Push("Solution");
         vecnames.Push("Derivative");
@@ -204,7 +965,7 @@ void SolveH1Problem(TPZCompMesh *cmeshH1,struct ProblemConfig &config, struct Pr
     std::cout << "FINISHED!" << std::endl;
 }
 
-void SolveHybridH1Problem(TPZMultiphysicsCompMesh *cmesh_H1Hybrid,int InterfaceMatId, struct ProblemConfig config,struct PreConfig &pConfig,int hybridLevel){
+void SolveHybridH1Problem(TPZMultiphysicsCompMesh *cmesh_H1Hybrid,int InterfaceMatId, struct ProblemConfig config,struct PreConfig &pConfig, LevelResult &level,int hybridLevel){
 
     config.exact.operator*().fSignConvention = 1;
 
@@ -212,37 +973,22 @@ void SolveHybridH1Problem(TPZMultiphysicsCompMesh *cmesh_H1Hybrid,int InterfaceM
 
     TPZAnalysis an(cmesh_H1Hybrid);
 
-#ifdef USING_MKL
-    TPZSymetricSpStructMatrix strmat(cmesh_H1Hybrid);
-    strmat.SetNumThreads(0);
-    //        strmat.SetDecomposeType(ELDLt);
-#else
-    //    TPZFrontStructMatrix<TPZFrontSym<STATE> > strmat(Hybridmesh);
-    //    strmat.SetNumThreads(2);
-    //    strmat.SetDecomposeType(ELDLt);
-    TPZSkylineStructMatrix strmat(cmesh_H1Hybrid);
-    strmat.SetNumThreads(0);
-#endif
     std::set<int> matIds;
     for (auto matid : config.materialids) matIds.insert(matid);
     for (auto matidbc : config.bcmaterialids) matIds.insert(matidbc);
 
     matIds.insert(InterfaceMatId);
-    strmat.SetMaterialIds(matIds);
-    an.SetStructuralMatrix(strmat);
-
-    TPZStepSolver<STATE>* direct = new TPZStepSolver<STATE>;
-    direct->SetDirect(ELDLt);
-    an.SetSolver(*direct);
-    delete direct;
-    direct = 0;
-    an.Assemble();
-    an.Solve();
-
-    int64_t nelem = cmesh_H1Hybrid->NElements();
-    cmesh_H1Hybrid->LoadSolution(cmesh_H1Hybrid->Solution());
-    cmesh_H1Hybrid->ExpandSolution();
-    cmesh_H1Hybrid->ElementSolution().Redim(nelem, 5);
+    SetupSolver(an, cmesh_H1Hybrid, pConfig, matIds);
+    if(level.variants.size()) AssembleAndSolveVariants(an,config,pConfig,level);
+    else AssembleAndSolve(an,pConfig,level);
+
+    {
+        TPZScopedTimer timer(level.phaseTime[EBackSubstitution], level.phaseCpu[EBackSubstitution]);
+        int64_t nelem = cmesh_H1Hybrid->NElements();
+        cmesh_H1Hybrid->LoadSolution(cmesh_H1Hybrid->Solution());
+        cmesh_H1Hybrid->ExpandSolution();
+        cmesh_H1Hybrid->ElementSolution().Redim(nelem, 5);
+    }
 
     ////Calculo do erro
     std::cout << "Computing Error HYBRID_H1 " << std::endl;
@@ -251,11 +997,12 @@ void SolveHybridH1Problem(TPZMultiphysicsCompMesh *cmesh_H1Hybrid,int InterfaceM
 
     std::cout << "DOF = " << cmesh_H1Hybrid->NEquations() << std::endl;
 
-   StockErrors(an,cmesh_H1Hybrid,pConfig.Erro,pConfig.Log,pConfig);
+    StockErrors(an,cmesh_H1Hybrid,level,pConfig);
 
     ////PostProcess
 
     if(pConfig.debugger) {
+        TPZScopedTimer timer(level.phaseTime[EPostProcessing], level.phaseCpu[EPostProcessing]);
         TPZStack<std::string> scalnames, vecnames;
         scalnames.Push("Pressure");
         scalnames.Push("PressureExact");
@@ -267,7 +1014,7 @@ void SolveHybridH1Problem(TPZMultiphysicsCompMesh *cmesh_H1Hybrid,int InterfaceM
             std::stringstream out;
             out << pConfig.plotfile /* << config.dir_name*/ << "/"
                 << config.problemname << "_k-" << config.k
-                << "_n-" << config.n << "_ref_" << 1/pConfig.h << " x " << 1/pConfig.h <<".vtk";
+                << "_n-" << config.n << "_ref_" << 1/level.h << " x " << 1/level.h <<".vtk";
             plotname = out.str();
         }
         int resolution = 0;
@@ -276,7 +1023,7 @@ void SolveHybridH1Problem(TPZMultiphysicsCompMesh *cmesh_H1Hybrid,int InterfaceM
     }
 }
 
-void SolveMixedProblem(TPZMultiphysicsCompMesh *cmesh_Mixed,struct ProblemConfig config,struct PreConfig &pConfig) {
+void SolveMixedProblem(TPZMultiphysicsCompMesh *cmesh_Mixed,struct ProblemConfig config,struct PreConfig &pConfig, LevelResult &level) {
 
     config.exact.operator*().fSignConvention = 1;
     bool optBW = true;
@@ -284,23 +1031,10 @@ void SolveMixedProblem(TPZMultiphysicsCompMesh *cmesh_Mixed,struct ProblemConfig
     std::cout << "Solving Mixed " << std::endl;
     TPZAnalysis an(cmesh_Mixed, optBW); //Cria objeto de análise que gerenciará a analise do problema
 
-    //MKL solver
-#ifdef USING_MKL
-    TPZSymetricSpStructMatrix strmat(cmesh_Mixed);
-    strmat.SetNumThreads(8);
-#else
-    TPZSkylineStructMatrix strmat(cmesh_H1Hybrid);
-    strmat.SetNumThreads(0);
-#endif
-    an.SetStructuralMatrix(strmat);
-
-    TPZStepSolver<STATE>* direct = new TPZStepSolver<STATE>;
-    direct->SetDirect(ELDLt);
-    an.SetSolver(*direct);
-    delete direct;
-    direct = 0;
-    an.Assemble();
-    an.Solve();
+    std::set<int> matids; // all materials
+    SetupSolver(an, cmesh_Mixed, pConfig, matids);
+    if(level.variants.size()) AssembleAndSolveVariants(an,config,pConfig,level);
+    else AssembleAndSolve(an,pConfig,level);
 
     ////Calculo do erro
     std::cout << "Computing Error MIXED " << std::endl;
@@ -309,10 +1043,11 @@ void SolveMixedProblem(TPZMultiphysicsCompMesh *cmesh_Mixed,struct ProblemConfig
 
     std::cout << "DOF = " << cmesh_Mixed->NEquations() << std::endl;
 
-    StockErrors(an,cmesh_Mixed,pConfig.Erro,pConfig.Log,pConfig);
+    StockErrors(an,cmesh_Mixed,level,pConfig);
 
     ////PostProcess
     if(pConfig.debugger) {
+        TPZScopedTimer timer(level.phaseTime[EPostProcessing], level.phaseCpu[EPostProcessing]);
 
         int dim = config.gmesh->Dimension();
         std::string plotname;
@@ -320,7 +1055,7 @@ void SolveMixedProblem(TPZMultiphysicsCompMesh *cmesh_Mixed,struct ProblemConfig
             std::stringstream out;
             out << pConfig.plotfile  << "/"
                 << config.problemname << "_Mixed_k-" << config.k
-                << "_n-" << config.n << "_ref-" << 1/pConfig.h <<" x " << 1/pConfig.h << ".vtk";
+                << "_n-" << config.n << "_ref-" << 1/level.h <<" x " << 1/level.h << ".vtk";
             plotname = out.str();
         }
 
@@ -336,50 +1071,17 @@ void SolveMixedProblem(TPZMultiphysicsCompMesh *cmesh_Mixed,struct ProblemConfig
     }
 }
 
-void StockErrorsH1(TPZAnalysis &an,TPZCompMesh *cmesh, ofstream &Erro, TPZVec<REAL> *Log,PreConfig &pConfig){
-
-    TPZManVector<REAL,6> Errors;
-    Errors.resize(pConfig.numErrors);
-    bool store_errors = false;
+void StockErrors(TPZAnalysis &an,TPZCompMesh *cmesh, LevelResult &level,PreConfig &pConfig){
 
-    an.PostProcessError(Errors, store_errors, Erro);
+    TPZScopedTimer timer(level.phaseTime[EErrorEvaluation], level.phaseCpu[EErrorEvaluation]);
 
-    if ((*Log)[0] != -1) {
-        for (int j = 0; j < 3; j++) {
-            (*pConfig.rate)[j] =
-                    (log10(Errors[j]) - log10((*Log)[j])) /
-                    (log10(pConfig.h) - log10(pConfig.hLog));
-            Erro << "rate " << j << ": " << (*pConfig.rate)[j] << std::endl;
-        }
-    }
-
-    Erro << "h = " << pConfig.h << std::endl;
-    Erro << "DOF = " << cmesh->NEquations() << std::endl;
-    for (int i = 0; i < pConfig.numErrors; i++)
-        (*Log)[i] = Errors[i];
-    Errors.clear();
-}
-
-void StockErrors(TPZAnalysis &an,TPZMultiphysicsCompMesh *cmesh, ofstream &Erro, TPZVec<REAL> *Log,PreConfig &pConfig){
-
-    TPZManVector<REAL,6> Errors;
-    Errors.resize(pConfig.numErrors);
+    level.errors.resize(pConfig.numErrors);
     bool store_errors = false;
 
-    an.PostProcessError(Errors, store_errors, Erro);
-
-    if ((*Log)[0] != -1) {
-        for (int j = 0; j < 3; j++) {
-            (*pConfig.rate)[j] =
-                    (log10(Errors[j]) - log10((*Log)[j])) /
-                    (log10(pConfig.h) - log10(pConfig.hLog));
-            Erro << "rate " << j << ": " << (*pConfig.rate)[j] << std::endl;
-        }
-    }
+    // the rates depend on the previous level and are computed once the study is over
+    std::stringstream out;
+    an.SetThreadsForError(pConfig.threads.error);
+    an.PostProcessError(level.errors, store_errors, out);
 
-    Erro << "h = " << pConfig.h << std::endl;
-    Erro << "DOF = " << cmesh->NEquations() << std::endl;
-    for (int i = 0; i < pConfig.numErrors; i++)
-        (*Log)[i] = Errors[i];
-    Errors.clear();
-}
\ No newline at end of file
+    level.dof = cmesh->NEquations();
+}
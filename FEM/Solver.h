@@ -11,31 +11,44 @@
 
 
 //// Call required methods to build a computational mesh for an Pryymal Hybrid approximation
-void CreateHybridH1ComputationalMesh(TPZMultiphysicsCompMesh *cmesh_H1Hybrid, int &InterfaceMatId,PreConfig &eData, ProblemConfig &config,int hybridLevel);
+void CreateHybridH1ComputationalMesh(TPZMultiphysicsCompMesh *cmesh_H1Hybrid, int &InterfaceMatId,PreConfig &eData, ProblemConfig &config,int hybridLevel, LevelResult &level);
 
 //// Call required methods to build a computational mesh for a Mixed approximation
-void CreateMixedComputationalMesh(TPZMultiphysicsCompMesh *cmesh_H1Mixed,PreConfig &eData, ProblemConfig &config);
+void CreateMixedComputationalMesh(TPZMultiphysicsCompMesh *cmesh_H1Mixed,PreConfig &eData, ProblemConfig &config, LevelResult &level);
 
 //// Solve classical H1 problem
-void SolveH1Problem(TPZCompMesh *cmeshH1,struct ProblemConfig &config, struct PreConfig &eData);
+void SolveH1Problem(TPZCompMesh *cmeshH1,struct ProblemConfig &config, struct PreConfig &eData, LevelResult &level);
 
 //// Solve Primal Hybrid problem
-void SolveHybridH1Problem(TPZMultiphysicsCompMesh *cmesh_H1Hybrid, int InterfaceMatId, struct ProblemConfig config, struct PreConfig &eData,int hybridLevel);
+void SolveHybridH1Problem(TPZMultiphysicsCompMesh *cmesh_H1Hybrid, int InterfaceMatId, struct ProblemConfig config, struct PreConfig &eData, LevelResult &level,int hybridLevel);
 
 //// Solve Mixed problem
-void SolveMixedProblem(TPZMultiphysicsCompMesh *cmesh_Mixed,struct ProblemConfig config,struct PreConfig &eData);
+void SolveMixedProblem(TPZMultiphysicsCompMesh *cmesh_Mixed,struct ProblemConfig config,struct PreConfig &eData, LevelResult &level);
 
-//// Error Management
-void StockErrorsH1(TPZAnalysis &an,TPZCompMesh *cmesh,ofstream &Erro, TPZVec<REAL> *Log, PreConfig &eData);
+//// True if name is a solver of the registry ("default", "skyline", "frontal", "sparse" with MKL, "pcg", "gmres")
+//// which can solve the system of approx; "pcg" needs a positive definite system and is offered for H1 only
+bool HasSolver(const std::string &name, const std::string &approx);
 
 //// Error Management
-void StockErrors(TPZAnalysis &an,TPZMultiphysicsCompMesh *cmesh,ofstream &Erro, TPZVec<REAL> *Log, PreConfig &eData);
+void StockErrors(TPZAnalysis &an,TPZCompMesh *cmesh, LevelResult &level, PreConfig &eData);
 
 //// Solve desired problem
-void Solve(ProblemConfig &config, PreConfig &preConfig);
+void Solve(ProblemConfig &config, PreConfig &preConfig, LevelResult &level);
+
+//// Solve the refinement levels from first on concurrently, on a pool of preConfig.threads.sweep threads
+//// The geometric meshes of configs must be created beforehand, since refinement patterns are shared between threads
+void SolveSweep(TPZVec<ProblemConfig> &configs, PreConfig &preConfig, TPZVec<LevelResult> &levels, int first);
+
+//// Run every refinement level of the case selected in preConfig and write its error table
+//// With preConfig.checkpointDir each solved level is saved, and a rerun resumes at the first level not saved
+void RunStudy(PreConfig &preConfig);
+
+//// Run all cases in one process, packing them on preConfig.threads.sweep threads from the largest to the smallest
+//// With reuseStructure the cases sharing a mesh are run one after the other by the same thread
+void RunBatch(TPZVec<BatchCase> &cases, const PreConfig &defaults);
 
 //// Draw geometric and computational mesh
-void DrawMesh(ProblemConfig &config, PreConfig &preConfig, TPZCompMesh *cmesh, TPZMultiphysicsCompMesh *multiCmesh);
+void DrawMesh(ProblemConfig &config, PreConfig &preConfig, LevelResult &level, TPZCompMesh *cmesh, TPZMultiphysicsCompMesh *multiCmesh);
 
 
 #endif //FEMCOMPARISON_ANALYTICS_H
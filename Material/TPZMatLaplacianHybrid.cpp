@@ -8,6 +8,7 @@
 #include "TPZMatLaplacianHybrid.h"
 #include "pzbndcond.h"
 #include "pzaxestools.h"
+#include "TPZPersistenceManager.h"
 
 TPZMatLaplacianHybrid::TPZMatLaplacianHybrid(int matid, int dim)
 : TPZRegisterClassId(&TPZMatLaplacianHybrid::ClassId), TPZMatLaplacian(matid,dim)
@@ -45,6 +46,8 @@ TPZMaterial *TPZMatLaplacianHybrid::NewMaterial()
 
 int TPZMatLaplacianHybrid::ClassId() const
 {
+    // the persistence manager stores the class ids of a file and refuses data written under another id,
+    // so the hashed name is the version of the layout: change it whenever Write gains members
     return Hash("TPZMatLaplacianHybrid") ^ TPZMatLaplacian::ClassId() << 1;
 }
 
@@ -57,6 +60,63 @@ void TPZMatLaplacianHybrid::Write(TPZStream &buf, int withclassid) const
 void TPZMatLaplacianHybrid::Read(TPZStream &buf, void *context)
 {
     TPZMatLaplacian::Read(buf,context);
+    // functions (permeability, forcing, exact solution) are not serialized, they have to be set again
+}
+
+/// adds scale * sum_kd dphi(kd,in)*dphi(kd,jn) to ek(in,jn) for in, jn < nshape
+// the gradients are gathered per direction so that the update of each column of ek is a unit stride
+// loop over in which the compiler can vectorize; dim is a template parameter so that the directions are unrolled
+template<int dim>
+static void AddGradGrad(const TPZFMatrix<REAL> &dphi, int nshape, STATE scale, TPZFMatrix<STATE> &ek)
+{
+    TPZManVector<REAL,3*64> grad(dim*nshape);
+    for (int in = 0; in < nshape; in++) {
+        for (int kd = 0; kd < dim; kd++) {
+            grad[kd*nshape+in] = dphi.GetVal(kd,in);
+        }
+    }
+    const REAL *g = &grad[0];
+    for (int jn = 0; jn < nshape; jn++) {
+        STATE s[dim];
+        for (int kd = 0; kd < dim; kd++) s[kd] = scale*g[kd*nshape+jn];
+        STATE *column = &ek(0,jn);
+        for (int in = 0; in < nshape; in++) {
+            STATE val = 0.;
+            for (int kd = 0; kd < dim; kd++) val += s[kd]*g[kd*nshape+in];
+            column[in] += val;
+        }
+    }
+}
+
+/// generic version for dimensions without specialization
+static void AddGradGrad(const TPZFMatrix<REAL> &dphi, int dim, int nshape, STATE scale, TPZFMatrix<STATE> &ek)
+{
+    for (int jn = 0; jn < nshape; jn++) {
+        for (int in = 0; in < nshape; in++) {
+            STATE val = 0.;
+            for (int kd = 0; kd < dim; kd++) val += dphi.GetVal(kd,in)*dphi.GetVal(kd,jn);
+            ek(in,jn) += scale*val;
+        }
+    }
+}
+
+void TPZMatLaplacianHybrid::EvaluateSourceAndPermeability(const TPZVec<REAL> &x, STATE &source, STATE &perm) const
+{
+    source = fXf;
+    if(fForcingFunction) {
+        TPZManVector<STATE,1> res(1);
+        fForcingFunction->Execute(x,res);
+        source = res[0];
+    }
+    
+    perm = fK;
+    if (fPermeabilityFunction) {
+        // the permeability is returned in the first entry of the derivative matrix
+        TPZManVector<STATE,3> func;
+        TPZFNMatrix<18,STATE> dfunc(6,3,0.);
+        fPermeabilityFunction->Execute(x, func, dfunc);
+        perm = dfunc(0,0);
+    }
 }
 
 int TPZMatLaplacianHybrid::VariableIndex(const std::string &name)
@@ -111,36 +171,25 @@ void TPZMatLaplacianHybrid::Contribute(TPZVec<TPZMaterialData> &datavec, REAL we
 
     int phr = phi.Rows();
     
-    STATE fXfLoc = fXf;
-    
-    if(fForcingFunction) {            // phi(in, 0) = phi_in
-        TPZManVector<STATE,1> res(1);
-        //TPZFMatrix<STATE> dres(Dimension(),1);
-        //fForcingFunction->Execute(x,res,dres);       // dphi(i,j) = dphi_j/dxi
-        fForcingFunction->Execute(x,res);
-        fXfLoc = res[0];
-    }
-    
-    STATE KPerm = fK;
-    if (fPermeabilityFunction) {
-        TPZFNMatrix<9,STATE> perm, invperm;
-        TPZManVector<STATE,3> func;
-        TPZFNMatrix<18,STATE> dfunc(6,3,0.);
-        fPermeabilityFunction->Execute(x, func, dfunc);
-        KPerm = dfunc(0,0);
-    }
+    STATE fXfLoc, KPerm;
+    EvaluateSourceAndPermeability(x, fXfLoc, KPerm);
     
     //Equacao de Poisson
     for( int in = 0; in < phr; in++ ) {
-        int kd;
         ef(in, 0) +=  (STATE)weight * fXfLoc * (STATE)phi(in,0);
-        
-        //matrix Sk
-        for( int jn = 0; jn < phr; jn++ ) {
-            for(kd=0; kd<fDim; kd++) {
-                ek(in,jn) += (STATE)weight*(KPerm*(STATE)(dphi(kd,in)*dphi(kd,jn)));
-            }
-        }
+    }
+    
+    //matrix Sk
+    switch (fDim) {
+        case 2:
+            AddGradGrad<2>(dphi, phr, (STATE)weight*KPerm, ek);
+            break;
+        case 3:
+            AddGradGrad<3>(dphi, phr, (STATE)weight*KPerm, ek);
+            break;
+        default:
+            AddGradGrad(dphi, fDim, phr, (STATE)weight*KPerm, ek);
+            break;
     }
     for (int in =0; in < phr; in++) {
         ek(phr,in) += weight*phi(in,0);//lambda*phi
@@ -149,10 +198,6 @@ void TPZMatLaplacianHybrid::Contribute(TPZVec<TPZMaterialData> &datavec, REAL we
     //equacoes de restricao de pressao media
     ek(phr,phr+1) -= weight;
     ek(phr+1,phr) -= weight;
-    
-    if (this->IsSymetric()){
-        if ( !ek.VerifySymmetry(1.e-10) ) std::cout << __PRETTY_FUNCTION__ << "\nMATRIZ NAO SIMETRICA" << std::endl;
-    }
 }
 
 void TPZMatLaplacianHybrid::Contribute(TPZVec<TPZMaterialData> &datavec, REAL weight, TPZFMatrix<STATE> &ef)
@@ -164,24 +209,8 @@ void TPZMatLaplacianHybrid::Contribute(TPZVec<TPZMaterialData> &datavec, REAL we
     //    TPZFMatrix<REAL> &jacinv = data.jacinv;
     int phr = phi.Rows();
     
-    STATE fXfLoc = fXf;
-    
-    if(fForcingFunction) {            // phi(in, 0) = phi_in
-        TPZManVector<STATE,1> res(1);
-        //TPZFMatrix<STATE> dres(Dimension(),1);
-        //fForcingFunction->Execute(x,res,dres);       // dphi(i,j) = dphi_j/dxi
-        fForcingFunction->Execute(x,res);
-        fXfLoc = res[0];
-    }
-    
-    STATE KPerm = fK;
-    if (fPermeabilityFunction) {
-        TPZFNMatrix<9,STATE> perm, invperm;
-        TPZManVector<STATE,3> func;
-        TPZFNMatrix<18,STATE> dfunc(6,3,0.);
-        fPermeabilityFunction->Execute(x, func, dfunc);
-        KPerm = dfunc(0,0);
-    }
+    STATE fXfLoc, KPerm;
+    EvaluateSourceAndPermeability(x, fXfLoc, KPerm);
     
     //Equacao de Poisson
     for( int in = 0; in < phr; in++ ) {
@@ -413,3 +442,6 @@ void TPZMatLaplacianHybrid::Errors(TPZVec<TPZMaterialData> &data, TPZVec<STATE>
 
     
 }
+
+// makes the material readable from a mesh snapshot
+template class TPZRestoreClass<TPZMatLaplacianHybrid>;
@@ -39,6 +39,9 @@ public:
     
     virtual int NEvalErrors()  override {return 4;}
     
+    /// source term and scalar permeability at the point x
+    void EvaluateSourceAndPermeability(const TPZVec<REAL> &x, STATE &source, STATE &perm) const;
+    
     virtual void Contribute(TPZVec<TPZMaterialData> &datavec, REAL weight, TPZFMatrix<STATE> &ek, TPZFMatrix<STATE> &ef) override;
     
     virtual void Contribute(TPZVec<TPZMaterialData> &datavec, REAL weight, TPZFMatrix<STATE> &ef) override;
@@ -55,8 +58,10 @@ public:
     virtual int ClassId() const override;
     
     
+    /// writes the base class data, this class adds none; its version is given by ClassId
     virtual void Write(TPZStream &buf, int withclassid) const override;
     
+    /// reads what Write wrote; the permeability and forcing functions are not restored
     virtual void Read(TPZStream &buf, void *context) override;
     
 
@@ -10,6 +10,7 @@
 
 #include <set>
 #include "TPZAnalyticSolution.h"
+#include "pzstack.h"
 
 /// class to guide the error estimator
 struct ProblemConfig
@@ -55,9 +56,60 @@ struct ProblemConfig
     ProblemConfig &operator=(const ProblemConfig &cp) = default;
 };
 
+/// phases of Solve() timed separately for each refinement level
+enum ESolvePhase {EMeshCreation, EAtomicMeshes, EInterfaces, ECondensation, EAssembly,
+    EFactorization, EBackSubstitution, EErrorEvaluation, EPostProcessing, ENumPhases};
+
+/// errors and sizes computed on a single refinement level
+struct LevelResult{
+    /// exact solution whose right hand side was solved
+    std::string problem;
+    /// rows of the right hand side variants solved with the matrix of this level (only while it is solved)
+    TPZVec<LevelResult *> variants;
+    /// number of uniform refinements of the level
+    int ndiv = -1;
+    /// element size
+    REAL h = -1;
+    /// number of equations of the global system
+    int64_t dof = -1;
+    /// errors returned by TPZAnalysis::PostProcessError
+    TPZManVector<REAL,6> errors;
+    /// convergence rates of the first three errors with respect to the previous level (empty on the first level)
+    TPZManVector<REAL,3> rates;
+    /// wall-clock seconds spent in Solve(); -1 for right hand side variants, whose solve is that of the level row
+    REAL time = -1;
+    /// wall-clock seconds spent in each phase of Solve(), indexed by ESolvePhase
+    REAL phaseTime[ENumPhases] = {};
+    /// processor seconds of the whole process spent in each phase, summed over its threads
+    REAL phaseCpu[ENumPhases] = {};
+    /// iterations and relative residual of the conjugate gradient (-1 for direct solvers)
+    int64_t iterations = -1;
+    REAL residual = -1;
+    /// resident memory (MB) of the process when the level was solved, before its meshes were released
+    REAL memory = -1;
+    /// peak resident memory (MB) of the process while the level was solved
+    /// -1 if other levels or cases were solved at the same time, or if the peak cannot be reset on this system
+    REAL peakMemory = -1;
+};
+
+/// number of threads of each parallel step; the meaning of 0 is given for each field
+struct ThreadingPolicy{
+    int assemble = 0;   // TPZStructMatrix::SetNumThreads; 0 = calling thread only
+    int factorize = 0;  // MKL threads of the factorization and back-substitution; 0 = MKL default, 1 if levels or cases run concurrently
+    int error = 0;      // TPZAnalysis::SetThreadsForError; 0 = calling thread only
+    int mesh = 0;       // searches over the elements while the hybrid H1 mesh is built and grouped; 0 = calling thread only
+    int sweep = 0;      // levels or batch cases solved concurrently; 0 = std::thread::hardware_concurrency()
+};
+
+/// one (problem, approximation, k, n) combination of a batch study
+struct BatchCase{
+    std::string problem;
+    std::string approx;
+    int k = 1;
+    int n = 1;
+};
+
 struct PreConfig{
-    std::ofstream Erro, timer;
-    TPZVec<REAL> *rate, *Log;
     int refLevel = -1;
 
     int k = 1;
@@ -68,15 +120,32 @@ struct PreConfig{
     REAL perm_Q1 = 5;
     REAL perm_Q2 = 1;
 
-    REAL hLog = -1, h = -1000;
+    REAL h = -1000;
     int numErrors = 4;
 
     std::string plotfile;
+    /// results of each refinement level, serialized once by FlushTable
+    TPZVec<LevelResult> results;
+    int tableFormat = 0;     // 0 = csv; 1 = json
+    std::string solver = "default"; // "default", "skyline", "frontal", "sparse" (MKL only), "pcg" (H1 only) or "gmres"
+    std::string preconditioner = "default"; // pcg and gmres: "element", "jacobi"; default = "jacobi" for pcg, "element" for gmres
+    REAL cgTolerance = 1.e-10;   // relative residual at which pcg and gmres stop
+    int64_t cgMaxIterations = 0; // 0 = number of equations
+    int gmresKrylov = 100;       // Krylov vectors of gmres before it restarts
+    TPZStack<std::string> rhsVariants; // other problems ("ESinSin", "EArcTan") solved with the same factorization
+    bool keepCondensedMatrices = false; // condensed elements keep their factorized matrices (memory!)
+    std::string snapshotDir;     // directory of the Hybrid and Mixed mesh snapshots; empty = meshes are always built
+    std::string checkpointDir;   // solved levels are saved here and a rerun of the study resumes after them; empty = off
+    bool reuseStructure = false; // batch only: keep the sparsity pattern of a mesh until its last case has run
     int mode = -1;           // 0 = "H1"; 1 = "Hybrid"; 2 = "Mixed";
     int argc = 1;
     int type= -1;
 
     bool debugger = true;
+    bool validateSymmetry = false; // check the symmetry of every element matrix once, after the level is solved
+    bool parallelSweep = false;  // solve all refinement levels concurrently
+    bool concurrentLevels = false; // set by SolveSweep and RunBatch: other levels or cases are solved at the same time
+    ThreadingPolicy threads;
     int exp = 2; // Initial exponent of mesh refinement (numElem = 2*2^exp)
 };
 
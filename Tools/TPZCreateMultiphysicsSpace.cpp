@@ -20,10 +20,34 @@
 
 #include "pzlog.h"
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #ifdef LOG4CXX
 static LoggerPtr logger(Logger::getLogger("CreateMultiphysicsSpace"));
 #endif
 
+/// number of contiguous ranges in which n items are processed by nthreads threads
+static int NumRanges(int64_t n, int nthreads)
+{
+    if(nthreads > n) nthreads = n;
+    return nthreads > 1 ? nthreads : 1;
+}
+
+/// call f(irange, first, last) for each of the nranges contiguous ranges of [0,n), each on its own thread
+template<class TFunc>
+static void ForEachRange(int64_t n, int nranges, TFunc f)
+{
+    auto work = [&](int irange){
+        f(irange, n*irange/nranges, n*(irange+1)/nranges);
+    };
+    std::vector<std::thread> pool;
+    for (int irange = 1; irange < nranges; irange++) pool.emplace_back(work, irange);
+    work(0);
+    for (auto &thread : pool) thread.join();
+}
+
 
 TPZCreateMultiphysicsSpace::TPZCreateMultiphysicsSpace(TPZGeoMesh *gmesh, MSpaceType spacetype) :
             fSpaceType(spacetype), fGeoMesh(gmesh) {
@@ -33,12 +57,20 @@ TPZCreateMultiphysicsSpace::TPZCreateMultiphysicsSpace(TPZGeoMesh *gmesh, MSpace
 /// copy constructor
 TPZCreateMultiphysicsSpace::TConfigH1Hybrid::TConfigH1Hybrid(const TConfigH1Hybrid &copy)
 {
-    
+    *this = copy;
 }
 
 /// copy operator
 TPZCreateMultiphysicsSpace::TConfigH1Hybrid &TPZCreateMultiphysicsSpace::TConfigH1Hybrid::operator=(const TConfigH1Hybrid &copy)
 {
+    fMatWrapId = copy.fMatWrapId;
+    fFluxMatId = copy.fFluxMatId;
+    fLagrangeMatid = copy.fLagrangeMatid;
+    fSecondLagrangeMatid = copy.fSecondLagrangeMatid;
+    fInterfacePressure = copy.fInterfacePressure;
+    fHybridizeBCLevel = copy.fHybridizeBCLevel;
+    fHybridSquared = copy.fHybridSquared;
+    fKeepCondensedMatrices = copy.fKeepCondensedMatrices;
     return *this;
 }
 
@@ -46,12 +78,23 @@ TPZCreateMultiphysicsSpace::TConfigH1Hybrid &TPZCreateMultiphysicsSpace::TConfig
 /// copy constructor
 TPZCreateMultiphysicsSpace::TPZCreateMultiphysicsSpace(const TPZCreateMultiphysicsSpace &copy)
 {
-    
+    *this = copy;
 }
 
 /// = operator
 TPZCreateMultiphysicsSpace & TPZCreateMultiphysicsSpace::operator=(const TPZCreateMultiphysicsSpace &copy)
 {
+    fSpaceType = copy.fSpaceType;
+    fMaterialIds = copy.fMaterialIds;
+    fBCMaterialIds = copy.fBCMaterialIds;
+    fIsBCMaterial = copy.fIsBCMaterial;
+    fBCMinMatId = copy.fBCMinMatId;
+    fDefaultPOrder = copy.fDefaultPOrder;
+    fDefaultLagrangeOrder = copy.fDefaultLagrangeOrder;
+    fDimension = copy.fDimension;
+    fGeoMesh = copy.fGeoMesh;
+    fNumThreads = copy.fNumThreads;
+    fH1Hybrid = copy.fH1Hybrid;
     return *this;
 }
 
@@ -110,7 +153,7 @@ bool TPZCreateMultiphysicsSpace::ShouldCreateFluxElement(TPZGeoElSide &gelside,
     {
         int matid = neighbour.Element()->MaterialId();
         if(matid == lagrangematid) return false;
-        if(fBCMaterialIds.find(matid) != fBCMaterialIds.end()) return false;
+        if(IsBCMaterial(matid)) return false;
         
         neighbour = neighbour.Neighbour();
     }
@@ -176,14 +219,14 @@ void TPZCreateMultiphysicsSpace::CreateLagrangeGeometricElements(TPZCompMesh *pr
     }
 }
 
-/// if there a neighbouring element with matid == lagrangematid -> return true
-static TPZGeoElSide HasBCNeighbour(const TPZGeoElSide &gelside, const std::set<int> &matbc)
+/// first neighbour of gelside with a boundary condition material id (an empty side if there is none)
+TPZGeoElSide TPZCreateMultiphysicsSpace::HasBCNeighbour(const TPZGeoElSide &gelside) const
 {
     TPZGeoElSide neighbour(gelside.Neighbour());
     while(neighbour != gelside)
     {
         int matid = neighbour.Element()->MaterialId();
-        if(matbc.find(matid) != matbc.end()) return neighbour;
+        if(IsBCMaterial(matid)) return neighbour;
         neighbour = neighbour.Neighbour();
     }
     return TPZGeoElSide();
@@ -222,7 +265,7 @@ void TPZCreateMultiphysicsSpace::CreatePressureBoundaryElements(TPZCompMesh *pre
             if(gel->SideDimension(side) != fDimension-1) continue;
             TPZGeoElSide gelside(gel,side);
             TPZGeoElSide neighbour = gelside.Neighbour();
-            TPZGeoElSide bcneighbour = HasBCNeighbour(gelside, fBCMaterialIds);
+            TPZGeoElSide bcneighbour = HasBCNeighbour(gelside);
             // the boundary condition element should be the first neighbour
             if(fH1Hybrid.fHybridizeBCLevel == 0 && bcneighbour && bcneighbour != neighbour) DebugStop();
             if(!bcneighbour && neighbour.Element()->MaterialId() != fH1Hybrid.fMatWrapId) DebugStop();
@@ -254,7 +297,7 @@ void TPZCreateMultiphysicsSpace::CreatePressureBoundaryElements(TPZCompMesh *pre
         {
             TPZGeoEl *gel = fGeoMesh->Element(el);
             int matid = gel->MaterialId();
-            if(fBCMaterialIds.find(matid) == fBCMaterialIds.end()) continue;
+            if(!IsBCMaterial(matid)) continue;
             int64_t index;
             TPZCompEl *cel = pressure->ApproxSpace().CreateCompEl(gel, *pressure, index);
 #ifdef LOG4CXX
@@ -456,104 +499,39 @@ TPZCompMesh *TPZCreateMultiphysicsSpace::CreateBoundaryFluxMesh()
 /// add interface elements to the multiphysics space
 void TPZCreateMultiphysicsSpace::AddInterfaceElements(TPZMultiphysicsCompMesh *mphys)
 {
-#ifdef LOG4CXX
-    std::map<int,int> numcreated;
-#endif
     TPZGeoMesh *gmesh = mphys->Reference();
     gmesh->ResetReference();
     mphys->LoadReferences();
     int64_t nel = mphys->NElements();
-    for (int64_t el = 0; el < nel; el++) {
-        TPZCompEl *cel = mphys->Element(el);
-        if(!cel) continue;
-        TPZGeoEl *gel = cel->Reference();
-        int matid = gel->MaterialId();
-//        if(matid != fH1Hybrid.fMatWrapId.first && matid != fH1Hybrid.fMatWrapId.second) continue;
-        if(matid == fH1Hybrid.fMatWrapId)
-        {
-            TPZCompEl *fluxel = FindFluxElement(cel);
-            TPZGeoEl *fluxgel = fluxel->Reference();
-            TPZGeoElSide gelside(gel);
-            TPZGeoElSide neighbour = gelside.Neighbour();
-            int neighmat = neighbour.Element()->MaterialId();
-            if(neighmat != fH1Hybrid.fLagrangeMatid.first && neighmat != fH1Hybrid.fLagrangeMatid.second)
-            {
-                DebugStop();
-            }
-            // determine if the interface should be positive or negative...
-            int interfacematid = neighmat;
-            int64_t index;
-            TPZCompElSide celwrap(cel,gel->NSides()-1);
-            TPZGeoElSide fluxgelside(fluxgel);
-            TPZCompElSide fluxside = fluxgelside.Reference();
-//            std::cout << "Creating interface from wrap element " << gel->Index() << " using neighbour " << neighbour.Element()->Index() <<
-//             " and flux element " << fluxgel->Index() << std::endl;
-            if(neighbour.Element()->Reference()) DebugStop();
-            new TPZMultiphysicsInterfaceElement(*mphys,neighbour.Element(),index,celwrap,fluxside);
-#ifdef LOG4CXX
-            numcreated[neighmat]++;
-#endif
+    
+    // the interface elements only reference lagrange multiplier elements, which are never searched for,
+    // so all of them can be found before the first one is created
+    // contiguous ranges keep the element order when the lists are concatenated
+    int nranges = NumRanges(nel, fNumThreads);
+    TPZVec<TPZStack<TInterfaceData>> found(nranges);
+    ForEachRange(nel, nranges, [&](int irange, int64_t first, int64_t last){
+        for (int64_t el = first; el < last; el++) {
+            TPZCompEl *cel = mphys->Element(el);
+            if(!cel) continue;
+            FindInterfaces(cel, found[irange]);
         }
-        if(fSpaceType == EH1HybridSquared && matid == fH1Hybrid.fFluxMatId)
-        {
-            TPZGeoElSide gelsideflux(gel);
-            TPZGeoElSide neighbour = gelsideflux.Neighbour();
-            // we only handle the flux element neighbour to second lagrange multiplier
-            if(neighbour.Element()->MaterialId() != fH1Hybrid.fSecondLagrangeMatid) continue;
-            TPZGeoElSide firstlagrange = neighbour;
-            TPZGeoElSide pressureinterface = firstlagrange.Neighbour();
-            if(pressureinterface.Element()->MaterialId() != fH1Hybrid.fInterfacePressure)
-            {
-                int pressmatid = pressureinterface.Element()->MaterialId();
-                if(fBCMaterialIds.find(pressmatid) == fBCMaterialIds.end()) DebugStop();
-            }
-            else {
-                TPZGeoElSide secondlagrange = pressureinterface.Neighbour();
-                if(secondlagrange.Element()->MaterialId() != fH1Hybrid.fSecondLagrangeMatid) DebugStop();
-                // now we have to find the second flux element
-                TPZGeoElSide fluxcandidate = secondlagrange.HasNeighbour(fH1Hybrid.fFluxMatId);
-                // if the fluxelement found is the first flux element
-                if(fluxcandidate == gelsideflux) {
-                    // we have to find a larger (lower level) flux element
-                    fluxcandidate = gelsideflux.HasLowerLevelNeighbour(fH1Hybrid.fFluxMatId);
-                    if(!fluxcandidate)
-                    {
-                        TPZManVector<REAL,3> x(3,0.);
-                        gelsideflux.CenterX(x);
-                        std::cout << "gelsideflux center " << x << std::endl;
-                        fluxcandidate = gelsideflux.HasLowerLevelNeighbour(fH1Hybrid.fFluxMatId);
-                        DebugStop();
-                    }
-#ifdef PZDEBUG
-                    if(fluxcandidate == gelsideflux)
-                    {
-                        DebugStop();
-                    }
-#endif
-                }
-                {
-                    TPZCompElSide celflux = fluxcandidate.Reference();
-                    TPZCompElSide pressure = pressureinterface.Reference();
-                    if(!celflux || !pressure) DebugStop();
-                    int64_t index;
-                    if(secondlagrange.Element()->Reference()) DebugStop();
-                    new TPZMultiphysicsInterfaceElement(*mphys,secondlagrange.Element(),index,celflux,pressure);
+    });
+    
+    // the elements are created serially, in the order of the serial search
 #ifdef LOG4CXX
-                    numcreated[secondlagrange.Element()->MaterialId()]++;
+    std::map<int,int> numcreated;
 #endif
-                }
-            }
-            {
-                TPZCompElSide celflux = gelsideflux.Reference();
-                TPZCompElSide pressure = pressureinterface.Reference();
-                if(!celflux || !pressure) DebugStop();
-                int64_t index;
+    for (int irange = 0; irange < nranges; irange++) {
+        TPZStack<TInterfaceData> &interfaces = found[irange];
+        int64_t ninterfaces = interfaces.size();
+        for (int64_t i = 0; i < ninterfaces; i++) {
+            TInterfaceData &data = interfaces[i];
+            if(data.fGeoEl->Reference()) DebugStop();
+            int64_t index;
+            new TPZMultiphysicsInterfaceElement(*mphys,data.fGeoEl,index,data.fLeft,data.fRight);
 #ifdef LOG4CXX
-                numcreated[firstlagrange.Element()->MaterialId()]++;
+            numcreated[data.fGeoEl->MaterialId()]++;
 #endif
-                if(firstlagrange.Element()->Reference()) DebugStop();
-                new TPZMultiphysicsInterfaceElement(*mphys,firstlagrange.Element(),index,celflux,pressure);
-            }
         }
     }
 #ifdef LOG4CXX
@@ -567,6 +545,96 @@ void TPZCreateMultiphysicsSpace::AddInterfaceElements(TPZMultiphysicsCompMesh *m
 #endif
 }
 
+/// append the interface elements that have to be created for cel, in the order they are created
+void TPZCreateMultiphysicsSpace::FindInterfaces(TPZCompEl *cel, TPZStack<TInterfaceData> &interfaces)
+{
+    TPZGeoEl *gel = cel->Reference();
+    int matid = gel->MaterialId();
+//        if(matid != fH1Hybrid.fMatWrapId.first && matid != fH1Hybrid.fMatWrapId.second) continue;
+    if(matid == fH1Hybrid.fMatWrapId)
+    {
+        TPZCompEl *fluxel = FindFluxElement(cel);
+        TPZGeoEl *fluxgel = fluxel->Reference();
+        TPZGeoElSide gelside(gel);
+        TPZGeoElSide neighbour = gelside.Neighbour();
+        int neighmat = neighbour.Element()->MaterialId();
+        if(neighmat != fH1Hybrid.fLagrangeMatid.first && neighmat != fH1Hybrid.fLagrangeMatid.second)
+        {
+            DebugStop();
+        }
+        // determine if the interface should be positive or negative...
+        TPZCompElSide celwrap(cel,gel->NSides()-1);
+        TPZGeoElSide fluxgelside(fluxgel);
+        TPZCompElSide fluxside = fluxgelside.Reference();
+//            std::cout << "Creating interface from wrap element " << gel->Index() << " using neighbour " << neighbour.Element()->Index() <<
+//             " and flux element " << fluxgel->Index() << std::endl;
+        TInterfaceData data;
+        data.fGeoEl = neighbour.Element();
+        data.fLeft = celwrap;
+        data.fRight = fluxside;
+        interfaces.Push(data);
+    }
+    if(fSpaceType == EH1HybridSquared && matid == fH1Hybrid.fFluxMatId)
+    {
+        TPZGeoElSide gelsideflux(gel);
+        TPZGeoElSide neighbour = gelsideflux.Neighbour();
+        // we only handle the flux element neighbour to second lagrange multiplier
+        if(neighbour.Element()->MaterialId() != fH1Hybrid.fSecondLagrangeMatid) return;
+        TPZGeoElSide firstlagrange = neighbour;
+        TPZGeoElSide pressureinterface = firstlagrange.Neighbour();
+        if(pressureinterface.Element()->MaterialId() != fH1Hybrid.fInterfacePressure)
+        {
+            int pressmatid = pressureinterface.Element()->MaterialId();
+            if(!IsBCMaterial(pressmatid)) DebugStop();
+        }
+        else {
+            TPZGeoElSide secondlagrange = pressureinterface.Neighbour();
+            if(secondlagrange.Element()->MaterialId() != fH1Hybrid.fSecondLagrangeMatid) DebugStop();
+            // now we have to find the second flux element
+            TPZGeoElSide fluxcandidate = secondlagrange.HasNeighbour(fH1Hybrid.fFluxMatId);
+            // if the fluxelement found is the first flux element
+            if(fluxcandidate == gelsideflux) {
+                // we have to find a larger (lower level) flux element
+                fluxcandidate = gelsideflux.HasLowerLevelNeighbour(fH1Hybrid.fFluxMatId);
+                if(!fluxcandidate)
+                {
+                    TPZManVector<REAL,3> x(3,0.);
+                    gelsideflux.CenterX(x);
+                    std::cout << "gelsideflux center " << x << std::endl;
+                    fluxcandidate = gelsideflux.HasLowerLevelNeighbour(fH1Hybrid.fFluxMatId);
+                    DebugStop();
+                }
+#ifdef PZDEBUG
+                if(fluxcandidate == gelsideflux)
+                {
+                    DebugStop();
+                }
+#endif
+            }
+            {
+                TPZCompElSide celflux = fluxcandidate.Reference();
+                TPZCompElSide pressure = pressureinterface.Reference();
+                if(!celflux || !pressure) DebugStop();
+                TInterfaceData data;
+                data.fGeoEl = secondlagrange.Element();
+                data.fLeft = celflux;
+                data.fRight = pressure;
+                interfaces.Push(data);
+            }
+        }
+        {
+            TPZCompElSide celflux = gelsideflux.Reference();
+            TPZCompElSide pressure = pressureinterface.Reference();
+            if(!celflux || !pressure) DebugStop();
+            TInterfaceData data;
+            data.fGeoEl = firstlagrange.Element();
+            data.fLeft = celflux;
+            data.fRight = pressure;
+            interfaces.Push(data);
+        }
+    }
+}
+
 /// group and condense the elements
 void TPZCreateMultiphysicsSpace::GroupandCondenseElements(TPZMultiphysicsCompMesh *cmesh)
 {
@@ -575,22 +643,22 @@ void TPZCreateMultiphysicsSpace::GroupandCondenseElements(TPZMultiphysicsCompMes
     TPZVec<int64_t> groupnumber(nel,-1);
     /// compute a groupnumber associated with each element
     AssociateElements(cmesh, groupnumber);
-    std::map<int64_t, TPZElementGroup *> groupmap;
+    /// the group numbers are element indices
+    TPZVec<TPZElementGroup *> groupmap(nel, 0);
+    /// groups in the order they were created
+    TPZStack<TPZElementGroup *> groups;
     //    std::cout << "Groups of connects " << groupindex << std::endl;
     for (int64_t el = 0; el<nel; el++) {
         int64_t groupnum = groupnumber[el];
         if(groupnum == -1) continue;
-        auto iter = groupmap.find(groupnum);
-        if (groupmap.find(groupnum) == groupmap.end()) {
+        TPZElementGroup *elgr = groupmap[groupnum];
+        if (!elgr) {
             int64_t index;
-            TPZElementGroup *elgr = new TPZElementGroup(*cmesh,index);
+            elgr = new TPZElementGroup(*cmesh,index);
             groupmap[groupnum] = elgr;
-            elgr->AddElement(cmesh->Element(el));
-        }
-        else
-        {
-            iter->second->AddElement(cmesh->Element(el));
+            groups.Push(elgr);
         }
+        elgr->AddElement(cmesh->Element(el));
         //        std::cout << std::endl;
     }
     cmesh->ComputeNodElCon();
@@ -602,14 +670,11 @@ void TPZCreateMultiphysicsSpace::GroupandCondenseElements(TPZMultiphysicsCompMes
             if(c.LagrangeMultiplier() == 5) c.IncrementElConnected();
         }
     }
-    nel = cmesh->NElements();
-    for (int64_t el = 0; el < nel; el++) {
-        TPZCompEl *cel = cmesh->Element(el);
-        TPZElementGroup *elgr = dynamic_cast<TPZElementGroup *> (cel);
-        if (elgr) {
-            TPZCondensedCompEl *cond = new TPZCondensedCompEl(elgr);
-            cond->SetKeepMatrix(false);
-        }
+    // the condensed element takes the place of the group in the element vector
+    int64_t ngroups = groups.size();
+    for (int64_t igr = 0; igr < ngroups; igr++) {
+        TPZCondensedCompEl *cond = new TPZCondensedCompEl(groups[igr]);
+        cond->SetKeepMatrix(fH1Hybrid.fKeepCondensedMatrices);
     }
 }
 
@@ -630,7 +695,7 @@ TPZCompEl *TPZCreateMultiphysicsSpace::FindFluxElement(TPZCompEl *wrapelement)
         if (matid == fH1Hybrid.fFluxMatId) {
             return cel;
         }
-        if (fH1Hybrid.fHybridizeBCLevel == 1 && fBCMaterialIds.find(matid) != fBCMaterialIds.end()) {
+        if (fH1Hybrid.fHybridizeBCLevel == 1 && IsBCMaterial(matid)) {
             return cel;
         }
     }
@@ -773,7 +838,7 @@ void TPZCreateMultiphysicsSpace::AddGeometricWrapElements()
 #endif
             // if the neighbour is a boundary condition and no hybridization is applied
             // do not create the wrap layers
-            bool HasBCNeighbour = (fBCMaterialIds.find(neighmat) != fBCMaterialIds.end());
+            bool HasBCNeighbour = IsBCMaterial(neighmat);
             if(fH1Hybrid.fHybridizeBCLevel == 0 && HasBCNeighbour)
             {
                 // no interface will be created between the element and a flux space
@@ -838,7 +903,7 @@ void TPZCreateMultiphysicsSpace::AddGeometricWrapElements()
         // if the neighbour is a boundary condition and no hybridization is applied
         // do not create the wrap layers
         int neighmat = neighbour.Element()->MaterialId();
-        bool HasBCNeighbour = (fBCMaterialIds.find(neighmat) != fBCMaterialIds.end());
+        bool HasBCNeighbour = IsBCMaterial(neighmat);
 
         auto lagrange = fH1Hybrid.fLagrangeMatid;
         bool islagrange = (matid == lagrange.first || matid == lagrange.second);
@@ -874,7 +939,7 @@ void TPZCreateMultiphysicsSpace::AddGeometricWrapElements()
             // now we can create the elements
             TPZGeoElSide neighbour = gelside.Neighbour();
             int neighmat = neighbour.Element()->MaterialId();
-            bool HasBCNeighbour = (fBCMaterialIds.find(neighmat) != fBCMaterialIds.end());
+            bool HasBCNeighbour = IsBCMaterial(neighmat);
 
             // lagrange element
             TPZGeoElBC gbc1(gelside, fH1Hybrid.fSecondLagrangeMatid);
@@ -910,6 +975,33 @@ void TPZCreateMultiphysicsSpace::AddGeometricWrapElements()
 #endif
 }
 
+/// root of the set of the connect, halving the path on the way
+static int64_t FindRoot(std::vector<std::atomic<int64_t>> &parent, int64_t c)
+{
+    int64_t p = parent[c].load();
+    while (p != c) {
+        int64_t gp = parent[p].load();
+        // another thread may have changed the parent of c in the meantime, then nothing is done
+        parent[c].compare_exchange_weak(p, gp);
+        c = p;
+        p = parent[c].load();
+    }
+    return c;
+}
+
+/// join the sets of the connects; the root with the largest index is linked to the other, so no cycle can form
+static void Union(std::vector<std::atomic<int64_t>> &parent, int64_t a, int64_t b)
+{
+    while (true) {
+        a = FindRoot(parent, a);
+        b = FindRoot(parent, b);
+        if (a == b) return;
+        if (a < b) std::swap(a, b);
+        int64_t expected = a;
+        if (parent[a].compare_exchange_strong(expected, b)) return;
+    }
+}
+
 /// Associate elements with a volumetric element
 // elementgroup[el] = index of the element with which the element should be grouped
 // this method only gives effective result for hybridized hdiv meshes
@@ -919,73 +1011,90 @@ void TPZCreateMultiphysicsSpace::AssociateElements(TPZCompMesh *cmesh, TPZVec<in
     elementgroup.Resize(nel, -1);
     elementgroup.Fill(-1);
     int64_t nconnects = cmesh->NConnects();
-    TPZVec<int64_t> groupindex(nconnects, -1);
     int dim = cmesh->Dimension();
-    for (TPZCompEl *cel : cmesh->ElementVec()) {
-        if (!cel || !cel->Reference() || cel->Reference()->Dimension() != dim) {
-            continue;
-        }
-        elementgroup[cel->Index()] = cel->Index();
-        TPZStack<int64_t> connectlist;
-        cel->BuildConnectList(connectlist);
-        for (auto cindex : connectlist) {
-#ifdef PZDEBUG
-            if (groupindex[cindex] != -1) {
-                DebugStop();
+    int nranges = NumRanges(nel, fNumThreads);
+
+    // connect lists of all elements in compressed rows, built once
+    TPZVec<int64_t> firstconnect(nel+1, 0);
+    TPZVec<int64_t> connects;
+    {
+        TPZVec<TPZStack<int64_t>> rangeconnects(nranges);
+        ForEachRange(nel, nranges, [&](int irange, int64_t first, int64_t last){
+            TPZStack<int64_t> connectlist;
+            for (int64_t el = first; el < last; el++) {
+                TPZCompEl *cel = cmesh->Element(el);
+                if (!cel || !cel->Reference()) continue;
+                connectlist.Resize(0);
+                cel->BuildConnectList(connectlist);
+                firstconnect[el+1] = connectlist.size();
+                for (auto cindex : connectlist) rangeconnects[irange].Push(cindex);
             }
+        });
+        for (int64_t el = 0; el < nel; el++) firstconnect[el+1] += firstconnect[el];
+        connects.Resize(firstconnect[nel]);
+        ForEachRange(nel, nranges, [&](int irange, int64_t first, int64_t last){
+            TPZStack<int64_t> &local = rangeconnects[irange];
+            int64_t offset = firstconnect[first];
+            for (int64_t i = 0; i < local.size(); i++) connects[offset+i] = local[i];
+        });
+    }
+
+    // the connects of each volumetric element form a group identified by the element index
+    // if HybridSquared the connects of interface elements with matid fLagrangeMatId join the group of
+    // their other connects, this incorporates the flux elements and the interface elements to the pressure
+    // lagrange DOFs in the group
+    std::vector<std::atomic<int64_t>> parent(nconnects);
+    TPZVec<int64_t> owner(nconnects, -1);
+    for (int64_t ic = 0; ic < nconnects; ic++) parent[ic] = ic;
+    ForEachRange(nel, nranges, [&](int irange, int64_t first, int64_t last){
+        for (int64_t el = first; el < last; el++) {
+            TPZCompEl *cel = cmesh->Element(el);
+            if (!cel || !cel->Reference()) continue;
+            bool volume = cel->Reference()->Dimension() == dim;
+            bool joins = volume || (fSpaceType == EH1HybridSquared &&
+                                    cel->Reference()->MaterialId() == fH1Hybrid.fLagrangeMatid.first);
+            if (!joins) continue;
+            for (int64_t i = firstconnect[el]; i < firstconnect[el+1]; i++) {
+                int64_t cindex = connects[i];
+                if (volume) {
+#ifdef PZDEBUG
+                    if (owner[cindex] != -1) {
+                        DebugStop();
+                    }
 #endif
-            groupindex[cindex] = cel->Index();
+                    owner[cindex] = el;
+                }
+                if (i > firstconnect[el]) Union(parent, connects[firstconnect[el]], cindex);
+            }
         }
+    });
+
+    // each set can hold the connects of a single volumetric element
+    TPZVec<int64_t> groupindex(nconnects, -1);
+    for (int64_t ic = 0; ic < nconnects; ic++) {
+        if (owner[ic] == -1) continue;
+        int64_t root = FindRoot(parent, ic);
+        if (groupindex[root] != -1 && groupindex[root] != owner[ic]) {
+            DebugStop();
+        }
+        groupindex[root] = owner[ic];
     }
 //    std::cout << "Groups of connects " << groupindex << std::endl;
-    int numloops = 1;
-    if(fSpaceType == EH1HybridSquared) numloops = 2;
-    // this loop will associate a first layer of interface elements to the group
-    // this loop will associate the wrap elements with the group
-    // if HybridSquared the connects of interface elements with matid fLagrangeMatId will be added to the group
-    // in the second pass :
-        // incorporate the flux elements in the group
-        // incorporate the interface elements to the pressure lagrange DOFs in the group
-    for (int iloop = 0; iloop < numloops; iloop++) for (TPZCompEl *cel : cmesh->ElementVec())
-    {
-        if (!cel || !cel->Reference()) {
-            continue;
-        }
-        TPZStack<int64_t> connectlist;
-        cel->BuildConnectList(connectlist);
-        int matid = cel->Reference()->MaterialId();
-        int64_t celindex = cel->Index();
-//        std::cout << "Analysing element " << celindex << " matid " << matid;
-//        std::cout << " connect list " << connectlist << std::endl;
-        TPZVec<int> connectgroup(connectlist.size());
-        for(int i=0; i<connectlist.size(); i++) connectgroup[i] = groupindex[connectlist[i]];
-//        std::cout << "groupindexes " << connectgroup << std::endl;
-        int64_t groupfound = -1;
-        for (auto cindex : connectlist) {
-            if (groupindex[cindex] != -1) {
-                elementgroup[celindex] = groupindex[cindex];
-                if(groupfound != -1 && groupfound != groupindex[cindex])
-                {
+
+    // an element belongs to the group of its connects
+    ForEachRange(nel, nranges, [&](int irange, int64_t first, int64_t last){
+        for (int64_t el = first; el < last; el++) {
+            int64_t groupfound = -1;
+            for (int64_t i = firstconnect[el]; i < firstconnect[el+1]; i++) {
+                int64_t group = groupindex[FindRoot(parent, connects[i])];
+                if (group == -1) continue;
+                if (groupfound != -1 && groupfound != group) {
                     DebugStop();
                 }
-//                if(groupfound == -1)
-//                {
-//                    std::cout << " added to " << groupindex[cindex];
-//                }
-                groupfound = groupindex[cindex];
+                groupfound = group;
             }
+            elementgroup[el] = groupfound;
         }
-        if(fSpaceType == EH1HybridSquared && matid == fH1Hybrid.fLagrangeMatid.first)
-        {
-//            std::cout << "Changing connect indexes group for element " << celindex;
-            for(auto cindex : connectlist)
-            {
-//                std::cout << " cindex " << cindex << " from " << groupindex[cindex] << " to " << groupfound << std::endl;
-                groupindex[cindex] = groupfound;
-            }
-        }
-
-//        std::cout << std::endl;
-    }
+    });
 }
 
@@ -11,8 +11,10 @@
 #include <stdio.h>
 #include <set>
 #include "pzmanvector.h"
+#include "pzcompel.h"
 class TPZCompMesh;
 class TPZGeoMesh;
+class TPZGeoEl;
 class TPZMultiphysicsCompMesh;
 class TPZCompEl;
 class TPZGeoElSide;
@@ -35,6 +37,12 @@ private:
     /// the boundary condition material ids
     std::set<int> fBCMaterialIds;
     
+    /// fIsBCMaterial[matid-fBCMinMatId] != 0 for the boundary condition material ids
+    TPZVec<char> fIsBCMaterial;
+    
+    /// smallest boundary condition material id
+    int fBCMinMatId = 0;
+    
     /// default internal order for the H1 elements
     int fDefaultPOrder = 3;
     
@@ -47,6 +55,17 @@ private:
     /// the geometric mesh which will generate the computational mesh
     TPZGeoMesh *fGeoMesh = 0;
     
+    /// number of threads of the search passes over the elements (0 = serial)
+    int fNumThreads = 0;
+    
+    /// interface element to be created: the geometric element that will hold it and the two sides it joins
+    struct TInterfaceData
+    {
+        TPZGeoEl *fGeoEl = 0;
+        TPZCompElSide fLeft;
+        TPZCompElSide fRight;
+    };
+    
 public:
     
     /// All parameters needed for creating a hybrid H1 space
@@ -73,6 +92,9 @@ public:
         bool fHybridSquared = false;
         /// indicates whether a second hybridizations will be applied
         
+        /// keep the condensed matrices of the element groups, so that loading the solution does not recompute them
+        bool fKeepCondensedMatrices = false;
+        
         /// default constructor
         TConfigH1Hybrid(){}
         
@@ -92,6 +114,11 @@ public:
         fDefaultLagrangeOrder = order;
     }
     
+    void SetNumThreads(int nthreads)
+    {
+        fNumThreads = nthreads;
+    }
+    
     
     /// object which contains the relevant information for create a hybrid H1 mesh
     TConfigH1Hybrid fH1Hybrid;
@@ -123,6 +150,18 @@ public:
     {
         fMaterialIds = matids;
         fBCMaterialIds = bc_matids;
+        fIsBCMaterial.Resize(0);
+        if(bc_matids.empty()) return;
+        fBCMinMatId = *bc_matids.begin();
+        fIsBCMaterial.Resize(*bc_matids.rbegin()-fBCMinMatId+1, 0);
+        for(auto matid : bc_matids) fIsBCMaterial[matid-fBCMinMatId] = 1;
+    }
+    
+    /// whether matid is a boundary condition material id
+    bool IsBCMaterial(int matid) const
+    {
+        int64_t pos = (int64_t)matid-fBCMinMatId;
+        return pos >= 0 && pos < fIsBCMaterial.size() && fIsBCMaterial[pos];
     }
     /// create meshes and elements for all geometric elements
     void CreateAtomicMeshes(TPZVec<TPZCompMesh *> &meshvec,int pressureOrder, int lagrangeorder);
@@ -163,9 +202,16 @@ private:
     /// Find the neighbouring flux element
     TPZCompEl *FindFluxElement(TPZCompEl *wrapelement);
     
+    /// append the interface elements that have to be created for cel, in the order they are created
+    // only reads the meshes, so it can be called concurrently for different elements
+    void FindInterfaces(TPZCompEl *cel, TPZStack<TInterfaceData> &interfaces);
+    
     /// if there a neighbouring element with matid == lagrangematid -> return true
     bool ShouldCreateFluxElement(TPZGeoElSide &gelside, int lagrangematid);
     
+    /// first neighbour of gelside with a boundary condition material id (an empty side if there is none)
+    TPZGeoElSide HasBCNeighbour(const TPZGeoElSide &gelside) const;
+    
     /// associate an element group index with the computational elements
     // the grouping of elements depends on the type of mesh created
     // in all cases the volumetric elements nucleate groups
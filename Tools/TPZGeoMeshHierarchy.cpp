@@ -0,0 +1,48 @@
+//
+//  TPZGeoMeshHierarchy.cpp
+//  FEMcomparison
+//
+
+#include "TPZGeoMeshHierarchy.h"
+#include "pzgeoel.h"
+#include "Tools.h"
+
+TPZGeoMeshHierarchy::TPZGeoMeshHierarchy(TPZGeoMesh *coarse) : fGeoMesh(coarse)
+{
+    if(!fGeoMesh) DebugStop();
+}
+
+TPZGeoMeshHierarchy::~TPZGeoMeshHierarchy()
+{
+    delete fGeoMesh;
+}
+
+void TPZGeoMeshHierarchy::RefineTo(int ndiv)
+{
+    if(ndiv < fLevel) DebugStop();
+    UniformRefinement(ndiv-fLevel, fGeoMesh);
+    fLevel = ndiv;
+}
+
+TPZGeoMesh *TPZGeoMeshHierarchy::LeafMesh(int ndiv)
+{
+    RefineTo(ndiv);
+    
+    TPZGeoMesh *leaf = new TPZGeoMesh;
+    leaf->SetDimension(fGeoMesh->Dimension());
+    // every node of a uniformly refined mesh belongs to a leaf element
+    leaf->NodeVec() = fGeoMesh->NodeVec();
+    leaf->SetMaxNodeId(fGeoMesh->NodeVec().NElements()-1);
+    
+    int64_t nel = fGeoMesh->NElements();
+    TPZManVector<int64_t,8> nodeindices;
+    for (int64_t el = 0; el < nel; el++) {
+        TPZGeoEl *gel = fGeoMesh->Element(el);
+        if(!gel || gel->HasSubElement()) continue;
+        gel->GetNodeIndices(nodeindices);
+        int64_t index;
+        leaf->CreateGeoElement(gel->Type(), nodeindices, gel->MaterialId(), index);
+    }
+    leaf->BuildConnectivity();
+    return leaf;
+}
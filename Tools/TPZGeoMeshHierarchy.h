@@ -0,0 +1,47 @@
+//
+//  TPZGeoMeshHierarchy.h
+//  FEMcomparison
+//
+
+#ifndef TPZGeoMeshHierarchy_h
+#define TPZGeoMeshHierarchy_h
+
+#include "pzgmesh.h"
+
+/// keeps a single geometric mesh and refines it uniformly one level at a time
+// the elements of the finest level are handed out as an independent mesh, since the computational
+// meshes add wrap and lagrange elements to the geometric mesh they are built on
+class TPZGeoMeshHierarchy
+{
+    /// refined mesh, owned by this object
+    TPZGeoMesh *fGeoMesh = 0;
+    
+    /// number of uniform refinements applied to fGeoMesh
+    int fLevel = 0;
+    
+public:
+    
+    /// takes ownership of the coarse mesh
+    TPZGeoMeshHierarchy(TPZGeoMesh *coarse);
+    
+    TPZGeoMeshHierarchy(const TPZGeoMeshHierarchy &copy) = delete;
+    
+    TPZGeoMeshHierarchy &operator=(const TPZGeoMeshHierarchy &copy) = delete;
+    
+    ~TPZGeoMeshHierarchy();
+    
+    /// number of uniform refinements applied so far
+    int Level() const
+    {
+        return fLevel;
+    }
+    
+    /// refine the mesh up to ndiv levels, only the missing levels are computed
+    void RefineTo(int ndiv);
+    
+    /// create a new mesh with the elements of level ndiv, the caller owns the returned mesh
+    // levels must be requested in non decreasing order
+    TPZGeoMesh *LeafMesh(int ndiv);
+};
+
+#endif /* TPZGeoMeshHierarchy_h */
@@ -0,0 +1,61 @@
+//
+//  TPZMemoryUsage.cpp
+//  FEMcomparison
+//
+
+#include "TPZMemoryUsage.h"
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#ifndef WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+REAL TPZMemoryUsage::CurrentRSS()
+{
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    long size = 0, resident = 0;
+    if(!(statm >> size >> resident)) return -1.;
+    return REAL(resident)*sysconf(_SC_PAGESIZE)/(1024.*1024.);
+#else
+    return -1.;
+#endif
+}
+
+REAL TPZMemoryUsage::PeakRSS()
+{
+#ifdef __linux__
+    // VmHWM follows the resets of ResetPeakRSS, ru_maxrss does not
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line)) {
+        if(line.compare(0, 6, "VmHWM:")) continue;
+        return std::atof(line.c_str()+6)/1024.; // kilobytes
+    }
+#endif
+#ifdef WIN32
+    return -1.;
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage)) return -1.;
+#ifdef __APPLE__
+    return REAL(usage.ru_maxrss)/(1024.*1024.); // bytes
+#else
+    return REAL(usage.ru_maxrss)/1024.; // kilobytes
+#endif
+#endif
+}
+
+bool TPZMemoryUsage::ResetPeakRSS()
+{
+#ifdef __linux__
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+    clear.close();
+    return !clear.fail();
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,27 @@
+//
+//  TPZMemoryUsage.h
+//  FEMcomparison
+//
+
+#ifndef TPZMemoryUsage_h
+#define TPZMemoryUsage_h
+
+#include "pzreal.h"
+
+/// resident memory of the running process, in megabytes
+// both values refer to the whole process: when levels are solved concurrently they include the other levels
+// a negative value is returned where the probe is not available
+namespace TPZMemoryUsage
+{
+    /// resident set size at the moment of the call
+    REAL CurrentRSS();
+    
+    /// largest resident set size reached since the last successful ResetPeakRSS, or since the process started
+    REAL PeakRSS();
+    
+    /// restart the high-water mark of PeakRSS at the current resident set size
+    // only Linux allows it (/proc/self/clear_refs); false where the mark cannot be reset
+    bool ResetPeakRSS();
+}
+
+#endif /* TPZMemoryUsage_h */
@@ -0,0 +1,54 @@
+//
+//  TPZScopedTimer.h
+//  FEMcomparison
+//
+
+#ifndef TPZScopedTimer_h
+#define TPZScopedTimer_h
+
+#include <chrono>
+#include <ctime>
+#include "pzreal.h"
+
+/// adds the wall-clock time elapsed during its lifetime, in seconds, to a variable
+// a monotonic clock is used so that multithreaded assembly and factorization are measured as the user perceives them
+// optionally the processor time of the process (summed over its threads) is accumulated as well
+class TPZScopedTimer
+{
+    /// variable which receives the elapsed time
+    REAL &fTarget;
+    
+    /// variable which receives the processor time, if any
+    REAL *fCpuTarget = 0;
+    
+    /// instant the timer was created
+    std::chrono::steady_clock::time_point fStart;
+    
+    /// processor time when the timer was created
+    std::clock_t fCpuStart;
+    
+public:
+    
+    TPZScopedTimer(REAL &target) : fTarget(target), fStart(std::chrono::steady_clock::now()), fCpuStart(0){}
+    
+    TPZScopedTimer(REAL &target, REAL &cputarget) : fTarget(target), fCpuTarget(&cputarget),
+        fStart(std::chrono::steady_clock::now()), fCpuStart(std::clock()){}
+    
+    TPZScopedTimer(const TPZScopedTimer &copy) = delete;
+    
+    TPZScopedTimer &operator=(const TPZScopedTimer &copy) = delete;
+    
+    ~TPZScopedTimer()
+    {
+        fTarget += Elapsed();
+        if(fCpuTarget) *fCpuTarget += REAL(std::clock() - fCpuStart)/CLOCKS_PER_SEC;
+    }
+    
+    /// seconds elapsed since the timer was created
+    REAL Elapsed() const
+    {
+        return std::chrono::duration<REAL>(std::chrono::steady_clock::now() - fStart).count();
+    }
+};
+
+#endif /* TPZScopedTimer_h */